@@ -1,38 +1,451 @@
- #include "appmenugtkmenuimporter.h"
-
-#include <QCoreApplication>
-#include <QDBusConnection>
-#include <QDBusInterface>
-#include <QDBusReply>
-#include <QDBusVariant>
-#include <QFont>
+/* This file is part of the appmenu plugin
+   Copyright 2017 Athor
+   Author: Aurelien Gateau <ria.freelander@gmail.com>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License (LGPL) as published by the Free Software Foundation;
+   either version 2 of the License, or (at your option) any later
+   version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+#include "appmenugtkmenuimporter.h"
+
+#include <accelparser.h>
+
+#include <QAction>
+#include <QHash>
+#include <QIcon>
+#include <QKeySequence>
 #include <QMenu>
+#include <QPixmap>
 #include <QPointer>
-#include <QTime>
-#include <QTimer>
-#include <QToolButton>
-#include <QWidgetAction>
-#include <QSet>
+#include <QVector>
 #include <QDebug>
 
-AppMenuGtkMenuImporter::AppMenuGtkMenuImporter(const QString &service, const QString &path,QObject *parent):QObject(parent)
+extern "C" {
+#include <gio/gio.h>
+#include "gtk/gtkactionmuxer.h"
+#include "gtk/gtkmenutracker.h"
+}
+
+class AppMenuGtkMenuImporterPrivate
+{
+public:
+    struct Binding;
+
+    struct Entry
+    {
+        GtkMenuTrackerItem *item;
+        QAction *action;
+        Binding *submenu;
+    };
+
+    /*
+     * A QMenu and the tracker feeding it. The entries mirror the tracker
+     * positions one to one, separators and hidden items included, so the
+     * ranges handed to the callbacks map straight onto the QMenu actions.
+     */
+    struct Binding
+    {
+        AppMenuGtkMenuImporterPrivate *d;
+        GtkMenuTrackerItem *owner;  // NULL for the menu bar
+        QMenu *menu;
+        GtkMenuTracker *tracker;    // NULL until populated
+        QVector<Entry> entries;
+    };
+
+    AppMenuGtkMenuImporter *q;
+    GDBusConnection *m_connection;
+    GtkActionMuxer *m_muxer;
+    QByteArray m_service;
+    QByteArray m_path;
+    QPointer<QMenu> m_menu;
+    Binding *m_root;
+    QHash<QMenu *, Binding *> m_bindings;
+
+    Binding *createBinding(QMenu *menu, GtkMenuTrackerItem *owner);
+    void populate(Binding *binding);
+    void freeBinding(Binding *binding);
+    void releaseEntry(Binding *binding, const Entry &entry);
+    void forgetBinding(Binding *binding);
+
+    QAction *createAction(Binding *binding, GtkMenuTrackerItem *item, Binding **submenu);
+    void updateAction(QAction *action, GtkMenuTrackerItem *item, const gchar *property);
+    QIcon iconFor(GIcon *icon);
+
+    static void itemsInserted(GtkMenuTrackerItem **items, gint position, gint n_items, gpointer user_data);
+    static void itemsRemoved(gint position, gint n_items, gpointer user_data);
+    static void itemChanged(GObject *object, GParamSpec *pspec, gpointer user_data);
+};
+
+static GQuark actionQuark()
 {
+    static GQuark quark = g_quark_from_static_string("appmenu-gtk-menu-importer-action");
+    return quark;
+}
 
+/*
+ * Converts a GTK mnemonic label ("_File", "Save __As") to Qt's
+ * ("&File", "Save _As"), escaping literal ampersands on the way.
+ */
+static QString textForLabel(const gchar *label)
+{
+    const QString source = QString::fromUtf8(label);
+    QString text;
+    text.reserve(source.size() + 1);
+
+    for (int i = 0; i < source.size(); i++) {
+        const QChar c = source.at(i);
+        if (c == QLatin1Char('_')) {
+            if (i + 1 < source.size() && source.at(i + 1) == QLatin1Char('_')) {
+                text += c;
+                i++;
+            } else {
+                text += QLatin1Char('&');
+            }
+        } else if (c == QLatin1Char('&')) {
+            text += QLatin1String("&&");
+        } else {
+            text += c;
+        }
+    }
+    return text;
+}
+
+AppMenuGtkMenuImporterPrivate::Binding *AppMenuGtkMenuImporterPrivate::createBinding(QMenu *menu, GtkMenuTrackerItem *owner)
+{
+    Binding *binding = new Binding;
+    binding->d = this;
+    binding->owner = owner;
+    binding->menu = menu;
+    binding->tracker = NULL;
+    m_bindings.insert(menu, binding);
+    return binding;
+}
+
+/*
+ * Starts tracking the model behind @binding. The tracker reports the
+ * items it already knows synchronously; a GDBusMenuModel that was not
+ * loaded yet follows with another insert once the reply arrives.
+ */
+void AppMenuGtkMenuImporterPrivate::populate(Binding *binding)
+{
+    if (binding->tracker) {
+        return;
+    }
+
+    if (binding->owner) {
+        binding->tracker = gtk_menu_tracker_new_for_item_submenu(binding->owner, itemsInserted, itemsRemoved, binding);
+    } else {
+        GDBusMenuModel *model = g_dbus_menu_model_get(m_connection, m_service.constData(), m_path.constData());
+        // the menu bar holds submenus only, its sections are merged without separators
+        binding->tracker = gtk_menu_tracker_new(GTK_ACTION_OBSERVABLE(m_muxer), G_MENU_MODEL(model), FALSE, NULL,
+                                                itemsInserted, itemsRemoved, binding);
+        g_object_unref(model);
+    }
+}
+
+void AppMenuGtkMenuImporterPrivate::freeBinding(Binding *binding)
+{
+    // freeing the tracker does not report removals, the entries go below
+    if (binding->tracker) {
+        gtk_menu_tracker_free(binding->tracker);
+    }
+
+    const QVector<Entry> &entries = binding->entries;
+    for (const Entry &entry : entries) {
+        releaseEntry(binding, entry);
+    }
+
+    m_bindings.remove(binding->menu);
+    delete binding;
+}
+
+void AppMenuGtkMenuImporterPrivate::releaseEntry(Binding *binding, const Entry &entry)
+{
+    g_signal_handlers_disconnect_by_func(entry.item, (gpointer) itemChanged, binding);
+    g_object_set_qdata(G_OBJECT(entry.item), actionQuark(), NULL);
+
+    if (entry.submenu) {
+        QMenu *submenu = entry.submenu->menu;
+        freeBinding(entry.submenu);
+        submenu->disconnect(q);
+        // the submenu may still be on screen, like the menu in ~AppMenuGtkMenuImporter()
+        submenu->deleteLater();
+    }
+
+    entry.action->disconnect(q);
+    binding->menu->removeAction(entry.action);
+    entry.action->deleteLater();
+
+    g_object_unref(entry.item);
+}
+
+/*
+ * Drops @binding and the bindings below it once their QMenu was destroyed
+ * from outside. The actions and submenus went with it, so only the tracker
+ * and the items are released here.
+ */
+void AppMenuGtkMenuImporterPrivate::forgetBinding(Binding *binding)
+{
+    if (binding->tracker) {
+        gtk_menu_tracker_free(binding->tracker);
+    }
+
+    const QVector<Entry> &entries = binding->entries;
+    for (const Entry &entry : entries) {
+        g_signal_handlers_disconnect_by_func(entry.item, (gpointer) itemChanged, binding);
+        g_object_set_qdata(G_OBJECT(entry.item), actionQuark(), NULL);
+        if (entry.submenu) {
+            forgetBinding(entry.submenu);
+        }
+        g_object_unref(entry.item);
+    }
+
+    m_bindings.remove(binding->menu);
+    delete binding;
+}
+
+QAction *AppMenuGtkMenuImporterPrivate::createAction(Binding *binding, GtkMenuTrackerItem *item, Binding **submenu)
+{
+    QAction *action = new QAction(binding->menu);
+    g_object_set_qdata(G_OBJECT(item), actionQuark(), action);
+    *submenu = NULL;
+
+    if (gtk_menu_tracker_item_get_is_separator(item)) {
+        action->setSeparator(true);
+    } else if (gtk_menu_tracker_item_get_has_submenu(item)) {
+        QMenu *menu = q->createMenu(binding->menu);
+        action->setMenu(menu);
+        *submenu = createBinding(menu, item);
+
+        QObject::connect(menu, &QMenu::aboutToShow, q, [this, menu]() {
+            Binding *binding = m_bindings.value(menu);
+            if (binding) {
+                populate(binding);
+                gtk_menu_tracker_item_request_submenu_shown(binding->owner, TRUE);
+            }
+        });
+        QObject::connect(menu, &QMenu::aboutToHide, q, [this, menu]() {
+            Binding *binding = m_bindings.value(menu);
+            if (binding) {
+                gtk_menu_tracker_item_request_submenu_shown(binding->owner, FALSE);
+            }
+        });
+    } else {
+        QObject::connect(action, &QAction::triggered, q, [item]() {
+            gtk_menu_tracker_item_activated(item);
+        });
+    }
+
+    updateAction(action, item, NULL);
+    g_signal_connect(item, "notify", G_CALLBACK(itemChanged), binding);
+    return action;
+}
+
+/*
+ * Copies @property of @item to @action, or all of them when @property
+ * is NULL.
+ */
+void AppMenuGtkMenuImporterPrivate::updateAction(QAction *action, GtkMenuTrackerItem *item, const gchar *property)
+{
+    const bool all = (property == NULL);
+
+    if (all || g_str_equal(property, "label")) {
+        action->setText(textForLabel(gtk_menu_tracker_item_get_label(item)));
+    }
+    if (all || g_str_equal(property, "visible")) {
+        action->setVisible(gtk_menu_tracker_item_get_visible(item));
+    }
+    if (action->isSeparator()) {
+        return;
+    }
+
+    if (all || g_str_equal(property, "sensitive")) {
+        action->setEnabled(gtk_menu_tracker_item_get_sensitive(item));
+    }
+    if (all || g_str_equal(property, "role") || g_str_equal(property, "toggled")) {
+        const bool checkable = gtk_menu_tracker_item_get_role(item) != GTK_MENU_TRACKER_ITEM_ROLE_NORMAL;
+        action->setCheckable(checkable);
+        action->setChecked(checkable && gtk_menu_tracker_item_get_toggled(item));
+    }
+    if (all || g_str_equal(property, "icon")) {
+        GIcon *icon = gtk_menu_tracker_item_get_icon(item);
+        action->setIcon(icon ? iconFor(icon) : QIcon());
+        if (icon) {
+            g_object_unref(icon);
+        }
+    }
+    if (all || g_str_equal(property, "accel")) {
+        action->setShortcut(AccelParser::toKeySequence(gtk_menu_tracker_item_get_accel(item)));
+    }
+}
+
+QIcon AppMenuGtkMenuImporterPrivate::iconFor(GIcon *icon)
+{
+    if (G_IS_THEMED_ICON(icon)) {
+        const gchar * const *names = g_themed_icon_get_names(G_THEMED_ICON(icon));
+        for (; names && *names; names++) {
+            const QIcon result = q->iconForName(QString::fromUtf8(*names));
+            if (!result.isNull()) {
+                return result;
+            }
+        }
+    } else if (G_IS_FILE_ICON(icon)) {
+        gchar *path = g_file_get_path(g_file_icon_get_file(G_FILE_ICON(icon)));
+        const QIcon result(QString::fromUtf8(path));
+        g_free(path);
+        return result;
+    } else if (G_IS_BYTES_ICON(icon)) {
+        gsize size = 0;
+        gconstpointer data = g_bytes_get_data(g_bytes_icon_get_bytes(G_BYTES_ICON(icon)), &size);
+        QPixmap pixmap;
+        if (pixmap.loadFromData(static_cast<const uchar *>(data), size)) {
+            return QIcon(pixmap);
+        }
+    }
+    return QIcon();
+}
+
+void AppMenuGtkMenuImporterPrivate::itemsInserted(GtkMenuTrackerItem **items, gint position, gint n_items, gpointer user_data)
+{
+    Binding *binding = static_cast<Binding *>(user_data);
+    AppMenuGtkMenuImporterPrivate *d = binding->d;
+
+    QAction *before = position < binding->entries.size() ? binding->entries.at(position).action : nullptr;
+
+    QList<QAction *> actions;
+    actions.reserve(n_items);
+    binding->entries.insert(position, n_items, Entry());
+    for (gint i = 0; i < n_items; i++) {
+        Entry &entry = binding->entries[position + i];
+        entry.item = GTK_MENU_TRACKER_ITEM(g_object_ref(items[i]));
+        entry.action = d->createAction(binding, entry.item, &entry.submenu);
+        actions.append(entry.action);
+    }
+    binding->menu->insertActions(before, actions);
+
+    Q_EMIT d->q->menuUpdated(binding->menu);
+}
+
+void AppMenuGtkMenuImporterPrivate::itemsRemoved(gint position, gint n_items, gpointer user_data)
+{
+    Binding *binding = static_cast<Binding *>(user_data);
+    AppMenuGtkMenuImporterPrivate *d = binding->d;
+
+    for (gint i = 0; i < n_items; i++) {
+        d->releaseEntry(binding, binding->entries.at(position + i));
+    }
+    binding->entries.remove(position, n_items);
+
+    Q_EMIT d->q->menuUpdated(binding->menu);
+}
+
+void AppMenuGtkMenuImporterPrivate::itemChanged(GObject *object, GParamSpec *pspec, gpointer user_data)
+{
+    Binding *binding = static_cast<Binding *>(user_data);
+    AppMenuGtkMenuImporterPrivate *d = binding->d;
+
+    QAction *action = static_cast<QAction *>(g_object_get_qdata(object, actionQuark()));
+    if (!action) {
+        return;
+    }
+
+    d->updateAction(action, GTK_MENU_TRACKER_ITEM(object), g_param_spec_get_name(pspec));
+
+    // the menu bar model lists the top level titles, tell it about renames
+    if (binding == d->m_root) {
+        Q_EMIT d->q->menuUpdated(binding->menu);
+    }
+}
+
+AppMenuGtkMenuImporter::AppMenuGtkMenuImporter(const QString &service, const QString &path, QObject *parent)
+: QObject(parent)
+, d(new AppMenuGtkMenuImporterPrivate)
+{
+    d->q = this;
+    d->m_connection = g_bus_get_sync(G_BUS_TYPE_SESSION, NULL, NULL);
+    d->m_muxer = gtk_action_muxer_new();
+    d->m_service = service.toUtf8();
+    d->m_path = path.toUtf8();
+    d->m_root = NULL;
 }
 
 AppMenuGtkMenuImporter::~AppMenuGtkMenuImporter()
 {
+    if (d->m_root) {
+        d->freeBinding(d->m_root);
+    }
+
+    // Do not use "delete d->m_menu": even if we are being deleted we should
+    // leave enough time for the menu to finish what it was doing, for example
+    // if it was being displayed.
+    if (d->m_menu) {
+        d->m_menu->deleteLater();
+    }
+
+    g_object_unref(d->m_muxer);
+    if (d->m_connection) {
+        g_object_unref(d->m_connection);
+    }
+    delete d;
+}
+
+void AppMenuGtkMenuImporter::insertActionGroup(const QString &prefix, const QString &path)
+{
+    if (!d->m_connection || path.isEmpty()) {
+        return;
+    }
+
+    GDBusActionGroup *group = g_dbus_action_group_get(d->m_connection, d->m_service.constData(), path.toUtf8().constData());
+    gtk_action_muxer_insert(d->m_muxer, prefix.toUtf8().constData(), G_ACTION_GROUP(group));
+    g_object_unref(group);
+}
+
+QMenu *AppMenuGtkMenuImporter::menu() const
+{
+    if (!d->m_menu) {
+        d->m_menu = createMenu(nullptr);
+        d->m_root = d->createBinding(d->m_menu, NULL);
 
+        // whoever shows the menu bar may delete it, a later call starts over
+        connect(d->m_menu.data(), &QObject::destroyed, this, [this]() {
+            if (d->m_root) {
+                d->forgetBinding(d->m_root);
+                d->m_root = NULL;
+            }
+        });
+    }
+    return d->m_menu;
 }
 
-QMenu* AppMenuGtkMenuImporter::menu() const
+void AppMenuGtkMenuImporter::updateMenu()
 {
-    return this->createMenu(nullptr);
+    updateMenu(menu());
 }
 
-void AppMenuGtkMenuImporter::updateMenu(QMenu* menu)
+void AppMenuGtkMenuImporter::updateMenu(QMenu *menu)
 {
+    AppMenuGtkMenuImporterPrivate::Binding *binding = d->m_bindings.value(menu);
+    if (!binding) {
+        qWarning() << "Not a menu of this importer" << menu;
+        return;
+    }
 
+    if (d->m_connection) {
+        d->populate(binding);
+    }
+    Q_EMIT menuUpdated(menu);
 }
 
 QMenu *AppMenuGtkMenuImporter::createMenu(QWidget *parent) const
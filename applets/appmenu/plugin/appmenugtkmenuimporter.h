@@ -22,27 +22,47 @@
 #define APPMENUGTKMENUIMPORTER_H
 
 #include <QtCore/QObject>
-#include <glib.h>
 
 class QAction;
-class QDBusPendingCallWatcher;
-class QDBusVariant;
 class QIcon;
 class QMenu;
 
 class AppMenuGtkMenuImporterPrivate;
 
-
+/**
+ * Builds a QMenu straight from the GMenuModel a GTK application exports
+ * as _GTK_MENUBAR_OBJECT_PATH, without going through dbusmenu.
+ *
+ * The menu is tracked with GtkMenuTracker: QActions are inserted, removed
+ * and updated in place as the application changes its model or action
+ * states. Actions resolve against the groups added with insertActionGroup().
+ */
 class AppMenuGtkMenuImporter: public QObject
 {
     Q_OBJECT
 public:
     AppMenuGtkMenuImporter(const QString &service, const QString &path, QObject *parent = 0);
     ~AppMenuGtkMenuImporter() override;
+
+    /**
+     * Makes the GActionGroup exported at @p path available to the menu
+     * items as "<prefix>.<action>", typically "app", "win" and "unity".
+     */
+    void insertActionGroup(const QString &prefix, const QString &path);
+
+    /**
+     * The menu bar, created on first use
+     */
     QMenu *menu() const;
-public Q_SLOTS:
 
+public Q_SLOTS:
+    /**
+     * Starts tracking the menu bar. menuUpdated() is emitted whenever
+     * the items of a tracked menu change.
+     */
+    void updateMenu();
     void updateMenu(QMenu *menu);
+
 Q_SIGNALS:
     void menuUpdated(QMenu *);
     void actionActivationRequested(QAction *);
@@ -52,8 +72,9 @@ protected:
     virtual QIcon iconForName(const QString &);
 
 private:
-    QMenu* m_menu;
     Q_DISABLE_COPY(AppMenuGtkMenuImporter)
+    AppMenuGtkMenuImporterPrivate *const d;
+    friend class AppMenuGtkMenuImporterPrivate;
 };
 
 #endif
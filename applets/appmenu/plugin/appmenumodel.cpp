@@ -25,11 +25,6 @@
 
 #include <config-X11.h>
 
-#if HAVE_X11
-#include <QX11Info>
-#include <xcb/xcb.h>
-#endif
-
 #include <QAction>
 #include <QMenu>
 #include <QDebug>
@@ -38,6 +33,9 @@
 
 #include <dbusmenuimporter.h>
 
+#include "appmenugtkmenuimporter.h"
+#include "gtkwindowmenu.h"
+
 static const QByteArray s_x11AppMenuServiceNamePropertyName = QByteArrayLiteral("_KDE_NET_WM_APPMENU_SERVICE_NAME");
 static const QByteArray s_x11AppMenuObjectPathPropertyName = QByteArrayLiteral("_KDE_NET_WM_APPMENU_OBJECT_PATH");
 
@@ -59,6 +57,24 @@ protected:
 
 };
 
+class KGtkMenuImporter : public AppMenuGtkMenuImporter
+{
+
+public:
+    KGtkMenuImporter(const QString &service, const QString &path, QObject *parent)
+        : AppMenuGtkMenuImporter(service, path, parent)
+    {
+
+    }
+
+protected:
+    QIcon iconForName(const QString &name) override
+    {
+        return QIcon::fromTheme(name);
+    }
+
+};
+
 AppMenuModel::AppMenuModel(QObject *parent)
             : QAbstractListModel(parent)
 {
@@ -122,46 +138,16 @@ void AppMenuModel::onActiveWindowChanged(WId id)
 {
 #if HAVE_X11
     if (KWindowSystem::isPlatformX11()) {
-        auto *c = QX11Info::connection();
-
-        static QHash<QByteArray, xcb_atom_t> s_atoms;
-
-        auto getWindowPropertyString = [c, this](WId id, const QByteArray &name) -> QByteArray {
-            QByteArray value;
-            if (!s_atoms.contains(name)) {
-                const xcb_intern_atom_cookie_t atomCookie = xcb_intern_atom(c, false, name.length(), name.constData());
-                QScopedPointer<xcb_intern_atom_reply_t, QScopedPointerPodDeleter> atomReply(xcb_intern_atom_reply(c, atomCookie, Q_NULLPTR));
-                if (atomReply.isNull()) {
-                    return value;
-                }
-
-                s_atoms[name] = atomReply->atom;
-                if (s_atoms[name] == XCB_ATOM_NONE) {
-                     return value;
-                }
-            }
-
-            static const long MAX_PROP_SIZE = 10000;
-            auto propertyCookie = xcb_get_property(c, false, id, s_atoms[name], XCB_ATOM_STRING, 0, MAX_PROP_SIZE);
-            QScopedPointer<xcb_get_property_reply_t, QScopedPointerPodDeleter> propertyReply(xcb_get_property_reply(c, propertyCookie, NULL));
-            if (propertyReply.isNull()) {
-                return value;
-            }
-
-            if (propertyReply->type == XCB_ATOM_STRING && propertyReply->format == 8 && propertyReply->value_len > 0) {
-                const char *data = (const char *) xcb_get_property_value(propertyReply.data());
-                int len = propertyReply->value_len;
-                if (data) {
-                    value = QByteArray(data, data[len - 1] ? len : len - 1);
-                }
+        auto updateMenuFromWindowIfHasMenu = [this](WId id) {
+            // GTK applications exporting a GMenuModel are imported natively
+            const GtkWindowMenu gtkMenu = GtkWindowMenu::fromWindow(id);
+            if (gtkMenu.isValid()) {
+                updateGtkApplicationMenu(gtkMenu.serviceName, gtkMenu.menuBarObjectPath, gtkMenu.actionGroupPaths);
+                return true;
             }
 
-            return value;
-        };
-
-        auto updateMenuFromWindowIfHasMenu = [this, &getWindowPropertyString](WId id) {
-            const QString serviceName = QString::fromUtf8(getWindowPropertyString(id, s_x11AppMenuServiceNamePropertyName));
-            const QString menuObjectPath = QString::fromUtf8(getWindowPropertyString(id, s_x11AppMenuObjectPathPropertyName));
+            const QString serviceName = QString::fromUtf8(windowPropertyString(id, s_x11AppMenuServiceNamePropertyName));
+            const QString menuObjectPath = QString::fromUtf8(windowPropertyString(id, s_x11AppMenuObjectPathPropertyName));
 
             if (!serviceName.isEmpty() && !menuObjectPath.isEmpty()) {
                 updateApplicationMenu(serviceName, menuObjectPath);
@@ -239,6 +225,9 @@ void AppMenuModel::updateApplicationMenu(const QString &serviceName, const QStri
     if (m_importer) {
         m_importer->deleteLater();
     }
+    if (m_gtkImporter) {
+        m_gtkImporter->deleteLater();
+    }
 
     m_importer = new KDBusMenuImporter(serviceName, menuObjectPath, this);
     QMetaObject::invokeMethod(m_importer, "updateMenu", Qt::QueuedConnection);
@@ -261,3 +250,46 @@ void AppMenuModel::updateApplicationMenu(const QString &serviceName, const QStri
     });
 }
 
+void AppMenuModel::updateGtkApplicationMenu(const QString &serviceName, const QString &menuBarObjectPath, const QHash<QString, QString> &actionGroupPaths)
+{
+    if (m_serviceName == serviceName && m_menuObjectPath == menuBarObjectPath) {
+        if (m_gtkImporter) {
+            QMetaObject::invokeMethod(m_gtkImporter, "updateMenu", Qt::QueuedConnection);
+        }
+        return;
+    }
+
+    m_serviceName = serviceName;
+    m_menuObjectPath = menuBarObjectPath;
+
+    if (m_importer) {
+        m_importer->deleteLater();
+    }
+    if (m_gtkImporter) {
+        m_gtkImporter->deleteLater();
+    }
+
+    m_gtkImporter = new KGtkMenuImporter(serviceName, menuBarObjectPath, this);
+    for (auto it = actionGroupPaths.constBegin(); it != actionGroupPaths.constEnd(); ++it) {
+        m_gtkImporter->insertActionGroup(it.key(), it.value());
+    }
+    QMetaObject::invokeMethod(m_gtkImporter, "updateMenu", Qt::QueuedConnection);
+
+    // emitted again whenever the application changes its menu bar
+    connect(m_gtkImporter.data(), &AppMenuGtkMenuImporter::menuUpdated, this, [=](QMenu *menu) {
+        m_menu = m_gtkImporter->menu();
+        if (m_menu.isNull() || menu != m_menu) {
+            return;
+        }
+
+        //track the first layer of sub menus, which we'll be popping up
+        for(QAction *a: m_menu->actions()) {
+            if (a->menu()) {
+                m_gtkImporter->updateMenu(a->menu());
+            }
+        }
+
+        setMenuAvailable(true);
+        Q_EMIT modelNeedsUpdate();
+    });
+}
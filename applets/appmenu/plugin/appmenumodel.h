@@ -28,6 +28,7 @@ class QMenu;
 class QAction;
 class QModelIndex;
 class KDBusMenuImporter;
+class KGtkMenuImporter;
 
 class AppMenuModel : public QAbstractListModel
 {
@@ -49,6 +50,7 @@ public:
     QHash<int, QByteArray> roleNames() const;
 
     void updateApplicationMenu(const QString &serviceName, const QString &menuObjectPath);
+    void updateGtkApplicationMenu(const QString &serviceName, const QString &menuBarObjectPath, const QHash<QString, QString> &actionGroupPaths);
 
     bool menuAvailable() const;
     void setMenuAvailable(bool set);
@@ -72,5 +74,6 @@ private:
     QString m_menuObjectPath;
 
     QPointer<KDBusMenuImporter> m_importer;
+    QPointer<KGtkMenuImporter> m_gtkImporter;
 };
 
@@ -32,8 +32,11 @@
 #include "appmenuadaptor.h"
 #include "appmenu_dbus.h"
 #include "verticalmenu.h"
+#include "gtkmenuexporter.h"
+#include "gtkwindowmenu.h"
 
 #include <QApplication>
+#include <QDBusConnectionInterface>
 #include <QDBusInterface>
 #include <QMenu>
 
@@ -77,7 +80,10 @@ AppMenuModule::AppMenuModule(QObject* parent, const QList<QVariant>&)
                                           this, SLOT(itemActivationRequested(int,uint)));
 }
 
-AppMenuModule::~AppMenuModule() = default;
+AppMenuModule::~AppMenuModule()
+{
+    qDeleteAll(m_gtkExporters);
+}
 
 void AppMenuModule::slotWindowRegistered(WId id, const QString &serviceName, const QDBusObjectPath &menuObjectPath)
 {
@@ -164,6 +170,65 @@ void AppMenuModule::slotShowMenu(int x, int y, const QString &serviceName, const
     });
 }
 
+void AppMenuModule::slotWindowAdded(WId id)
+{
+#if HAVE_X11
+    if (!KWindowSystem::isPlatformX11() || m_gtkExporters.contains(id)) {
+        return;
+    }
+
+    // the window already has a dbusmenu, e.g. through appmenu-gtk-module.
+    // One pointing at us or at a name gone from the bus is left over from
+    // an earlier (e.g. crashed) kded and gets replaced
+    const QString existingService = QString::fromUtf8(windowPropertyString(id, s_x11AppMenuServiceNamePropertyName));
+    if (!existingService.isEmpty()) {
+        QDBusConnection bus = QDBusConnection::sessionBus();
+        if (existingService != bus.baseService() && bus.interface()->isServiceRegistered(existingService)) {
+            return;
+        }
+    }
+
+    const GtkWindowMenu gtkMenu = GtkWindowMenu::fromWindow(id);
+    if (!gtkMenu.isValid()) {
+        return;
+    }
+
+    auto *exporter = new GtkMenuExporter(gtkMenu.serviceName, gtkMenu.menuBarObjectPath, gtkMenu.actionGroupPaths, this);
+    const QDBusObjectPath path(QStringLiteral("/MenuBar/%1").arg(id));
+    if (!exporter->registerOnBus(path)) {
+        delete exporter;
+        return;
+    }
+
+    m_gtkExporters.insert(id, exporter);
+    slotWindowRegistered(id, QDBusConnection::sessionBus().baseService(), path);
+#else
+    Q_UNUSED(id);
+#endif
+}
+
+void AppMenuModule::slotWindowRemoved(WId id)
+{
+    delete m_gtkExporters.take(id);
+}
+
+void AppMenuModule::setGtkMenuExportEnabled(bool enabled)
+{
+    if (!enabled) {
+        disconnect(KWindowSystem::self(), &KWindowSystem::windowAdded, this, &AppMenuModule::slotWindowAdded);
+        disconnect(KWindowSystem::self(), &KWindowSystem::windowRemoved, this, &AppMenuModule::slotWindowRemoved);
+        qDeleteAll(m_gtkExporters);
+        m_gtkExporters.clear();
+        return;
+    }
+
+    connect(KWindowSystem::self(), &KWindowSystem::windowAdded, this, &AppMenuModule::slotWindowAdded, Qt::UniqueConnection);
+    connect(KWindowSystem::self(), &KWindowSystem::windowRemoved, this, &AppMenuModule::slotWindowRemoved, Qt::UniqueConnection);
+    for (WId id : KWindowSystem::windows()) {
+        slotWindowAdded(id);
+    }
+}
+
 void AppMenuModule::hideMenu()
 {
     if (m_menu) {
@@ -190,6 +255,7 @@ void AppMenuModule::reconfigure()
     if (menuStyle == QLatin1String("InApplication")) {
         delete m_menuImporter;
         m_menuImporter = nullptr;
+        setGtkMenuExportEnabled(false);
         return;
     }
 
@@ -199,6 +265,8 @@ void AppMenuModule::reconfigure()
         connect(m_menuImporter, &MenuImporter::WindowRegistered, this, &AppMenuModule::slotWindowRegistered);
         m_menuImporter->connectToBus();
     }
+
+    setGtkMenuExportEnabled(true);
 }
 
 #include "appmenu.moc"
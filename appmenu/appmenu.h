@@ -29,12 +29,14 @@
 
 #include <kdedmodule.h>
 
+#include <QHash>
 #include <QPointer>
 #include "menuimporter.h"
 
 class QDBusPendingCallWatcher;
 class KDBusMenuImporter;
 class AppmenuDBus;
+class GtkMenuExporter;
 class TopMenuBar;
 class VerticalMenu;
 
@@ -82,9 +84,18 @@ private Q_SLOTS:
 
     void itemActivationRequested(int winId, uint action);
 
+    /**
+     * Exports the GMenuModel menu bar of a GTK window over dbusmenu
+     * and advertises it through the window properties
+     */
+    void slotWindowAdded(WId id);
+    void slotWindowRemoved(WId id);
+
 private:
     void hideMenu();
 
+    void setGtkMenuExportEnabled(bool enabled);
+
     void fakeUnityAboutToShow(const QString &service, const QDBusObjectPath &menuObjectPath);
 
     KDBusMenuImporter *getImporter(const QString &service, const QString &path);
@@ -92,6 +103,7 @@ private:
     MenuImporter *m_menuImporter = nullptr;
     AppmenuDBus *m_appmenuDBus;
     QPointer<VerticalMenu> m_menu;
+    QHash<WId, GtkMenuExporter *> m_gtkExporters;
 
     QAction *m_waitingAction = nullptr;
 };
@@ -0,0 +1,538 @@
+/*
+  This file is part of the KDE project.
+
+  Permission is hereby granted, free of charge, to any person obtaining a
+  copy of this software and associated documentation files (the "Software"),
+  to deal in the Software without restriction, including without limitation
+  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+  and/or sell copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+  DEALINGS IN THE SOFTWARE.
+*/
+
+#include "gtkmenuexporter.h"
+#include "dbusmenuadaptor.h"
+#include "dbusmenushortcut_p.h"
+
+#include <unitymenumodel.h>
+
+#include <QDBusConnection>
+#include <QKeySequence>
+#include <QTimer>
+
+static const QString s_themeIconPrefix = QStringLiteral("image://theme/");
+
+/*
+ * Properties the dbusmenu importer reads only when it creates an
+ * action; a change to them needs the parent layout to be fetched again.
+ */
+static bool isStructuralProperty(const QString &key)
+{
+    return key == QLatin1String("type") || key == QLatin1String("toggle-type")
+        || key == QLatin1String("children-display");
+}
+
+static bool sameValue(const QString &key, const QVariant &a, const QVariant &b)
+{
+    // no equality comparator is registered for the shortcut type
+    if (key == QLatin1String("shortcut")) {
+        return a.value<DBusMenuShortcut>() == b.value<DBusMenuShortcut>();
+    }
+    return a == b;
+}
+
+static int roleOf(const UnityMenuModel *menu, const QByteArray &name)
+{
+    static QHash<QByteArray, int> s_roles;
+    if (s_roles.isEmpty()) {
+        const QHash<int, QByteArray> names = menu->roleNames();
+        for (auto it = names.constBegin(); it != names.constEnd(); ++it) {
+            s_roles.insert(it.value(), it.key());
+        }
+    }
+    return s_roles.value(name, -1);
+}
+
+GtkMenuExporter::GtkMenuExporter(const QString &service, const QString &menuBarPath,
+                                 const QHash<QString, QString> &actionGroupPaths, QObject *parent)
+    : QObject(parent)
+    , m_flushTimer(new QTimer(this))
+{
+    DBusMenuTypes_register();
+
+    // collect everything that changes during one event loop turn
+    m_flushTimer->setSingleShot(true);
+    m_flushTimer->setInterval(0);
+    connect(m_flushTimer, &QTimer::timeout, this, &GtkMenuExporter::flush);
+
+    m_root = new Node;
+    m_root->id = 0;
+    m_root->parent = nullptr;
+    m_root->menu = nullptr;
+    m_root->properties.insert(QStringLiteral("children-display"), QStringLiteral("submenu"));
+    m_nodes.insert(m_root->id, m_root);
+
+    QVariantMap actions;
+    for (auto it = actionGroupPaths.constBegin(); it != actionGroupPaths.constEnd(); ++it) {
+        if (!it.value().isEmpty()) {
+            actions.insert(it.key(), it.value().toUtf8());
+        }
+    }
+
+    UnityMenuModel *menu = new UnityMenuModel(this);
+    watchMenu(menu, m_root);
+    menu->setBusName(service.toUtf8());
+    menu->setActions(actions);
+    menu->setMenuObjectPath(menuBarPath.toUtf8());
+}
+
+GtkMenuExporter::~GtkMenuExporter()
+{
+    if (!m_objectPath.path().isEmpty()) {
+        QDBusConnection::sessionBus().unregisterObject(m_objectPath.path());
+    }
+    destroyNode(m_root);
+}
+
+bool GtkMenuExporter::registerOnBus(const QDBusObjectPath &path)
+{
+    new DBusMenuAdaptor(this);
+    if (!QDBusConnection::sessionBus().registerObject(path.path(), this)) {
+        return false;
+    }
+    m_objectPath = path;
+    return true;
+}
+
+uint GtkMenuExporter::version() const
+{
+    return 3;
+}
+
+QString GtkMenuExporter::status() const
+{
+    return QStringLiteral("normal");
+}
+
+void GtkMenuExporter::Event(int id, const QString &eventId, const QDBusVariant &/*data*/, uint /*timestamp*/)
+{
+    Node *node = m_nodes.value(id);
+    if (!node || !node->parent || !node->parent->menu) {
+        return;
+    }
+
+    if (eventId == QLatin1String("clicked")) {
+        node->parent->menu->activate(rowOf(node));
+    }
+}
+
+QDBusVariant GtkMenuExporter::GetProperty(int id, const QString &property)
+{
+    Node *node = m_nodes.value(id);
+    if (!node || !node->properties.contains(property)) {
+        // an invalid variant cannot be marshalled
+        return QDBusVariant(QString());
+    }
+    return QDBusVariant(node->properties.value(property));
+}
+
+uint GtkMenuExporter::GetLayout(int parentId, int recursionDepth, const QStringList &propertyNames, DBusMenuLayoutItem &item)
+{
+    Node *node = m_nodes.value(parentId);
+    if (!node) {
+        item.id = parentId;
+        return m_revision;
+    }
+
+    if (recursionDepth != 0) {
+        loadSubmenu(node);
+    }
+    fillLayoutItem(node, recursionDepth, propertyNames, item);
+    return m_revision;
+}
+
+DBusMenuItemList GtkMenuExporter::GetGroupProperties(const QList<int> &ids, const QStringList &propertyNames)
+{
+    DBusMenuItemList list;
+    list.reserve(ids.count());
+    for (int id : ids) {
+        Node *node = m_nodes.value(id);
+        if (!node) {
+            continue;
+        }
+
+        DBusMenuItem item;
+        item.id = id;
+        if (propertyNames.isEmpty()) {
+            item.properties = node->properties;
+        } else {
+            for (const QString &name : propertyNames) {
+                auto it = node->properties.constFind(name);
+                if (it != node->properties.constEnd()) {
+                    item.properties.insert(name, it.value());
+                }
+            }
+        }
+        list << item;
+    }
+    return list;
+}
+
+bool GtkMenuExporter::AboutToShow(int id)
+{
+    Node *node = m_nodes.value(id);
+    return node && loadSubmenu(node);
+}
+
+void GtkMenuExporter::slotRowsInserted(const QModelIndex &/*parent*/, int first, int last)
+{
+    UnityMenuModel *menu = static_cast<UnityMenuModel *>(sender());
+    Node *node = m_menus.value(menu);
+    if (!node) {
+        return;
+    }
+
+    node->children.insert(first, last - first + 1, nullptr);
+    for (int row = first; row <= last; row++) {
+        Node *child = createNode(node);
+        child->properties = propertiesFor(menu, row);
+        node->children[row] = child;
+    }
+    layoutChanged(node);
+}
+
+void GtkMenuExporter::slotRowsRemoved(const QModelIndex &/*parent*/, int first, int last)
+{
+    Node *node = m_menus.value(static_cast<UnityMenuModel *>(sender()));
+    if (!node) {
+        return;
+    }
+
+    for (int row = first; row <= last; row++) {
+        destroyNode(node->children.at(row));
+    }
+    node->children.remove(first, last - first + 1);
+    layoutChanged(node);
+}
+
+void GtkMenuExporter::slotDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight, const QVector<int> &/*roles*/)
+{
+    UnityMenuModel *menu = static_cast<UnityMenuModel *>(sender());
+    Node *node = m_menus.value(menu);
+    if (!node) {
+        return;
+    }
+
+    // rebuilding the row is cheap, the diff keeps the signal minimal
+    const int last = qMin(bottomRight.row(), node->children.count() - 1);
+    for (int row = topLeft.row(); row <= last; row++) {
+        updateProperties(node->children.at(row), propertiesFor(menu, row));
+    }
+}
+
+void GtkMenuExporter::slotModelReset()
+{
+    UnityMenuModel *menu = static_cast<UnityMenuModel *>(sender());
+    Node *node = m_menus.value(menu);
+    if (!node) {
+        return;
+    }
+
+    const QVector<Node *> children = node->children;
+    node->children.clear();
+    for (Node *child : children) {
+        destroyNode(child);
+    }
+
+    const int count = menu->rowCount();
+    node->children.reserve(count);
+    for (int row = 0; row < count; row++) {
+        Node *child = createNode(node);
+        child->properties = propertiesFor(menu, row);
+        node->children << child;
+    }
+    layoutChanged(node);
+}
+
+void GtkMenuExporter::flush()
+{
+    if (!m_layoutChanged.isEmpty()) {
+        const QSet<int> changed = m_layoutChanged;
+        m_layoutChanged.clear();
+        m_revision++;
+
+        for (int id : changed) {
+            Node *node = m_nodes.value(id);
+            if (!node) {
+                continue;
+            }
+
+            // a changed ancestor already makes clients fetch this subtree
+            bool covered = false;
+            for (Node *parent = node->parent; parent && !covered; parent = parent->parent) {
+                covered = changed.contains(parent->id);
+            }
+            if (!covered) {
+                Q_EMIT LayoutUpdated(m_revision, id);
+            }
+        }
+    }
+
+    if (!m_propertiesChanged.isEmpty()) {
+        DBusMenuItemList updatedList;
+        DBusMenuItemKeysList removedList;
+
+        const QSet<int> changed = m_propertiesChanged;
+        m_propertiesChanged.clear();
+
+        for (int id : changed) {
+            Node *node = m_nodes.value(id);
+            if (!node) {
+                continue;
+            }
+
+            if (!node->updated.isEmpty()) {
+                DBusMenuItem item;
+                item.id = id;
+                for (const QString &key : node->updated) {
+                    item.properties.insert(key, node->properties.value(key));
+                }
+                updatedList << item;
+            }
+            if (!node->removed.isEmpty()) {
+                DBusMenuItemKeys keys;
+                keys.id = id;
+                keys.properties = node->removed.toList();
+                removedList << keys;
+            }
+            node->updated.clear();
+            node->removed.clear();
+        }
+
+        if (!updatedList.isEmpty() || !removedList.isEmpty()) {
+            Q_EMIT ItemsPropertiesUpdated(updatedList, removedList);
+        }
+    }
+}
+
+GtkMenuExporter::Node *GtkMenuExporter::createNode(Node *parent)
+{
+    // ids are never handed out twice, clients may still hold old ones
+    if (m_nextId <= 0) {
+        m_nextId = 1;
+    }
+
+    Node *node = new Node;
+    node->id = m_nextId++;
+    node->parent = parent;
+    node->menu = nullptr;
+    m_nodes.insert(node->id, node);
+    return node;
+}
+
+void GtkMenuExporter::destroyNode(Node *node)
+{
+    const QVector<Node *> &children = node->children;
+    for (Node *child : children) {
+        destroyNode(child);
+    }
+
+    if (node->menu) {
+        disconnect(node->menu, nullptr, this, nullptr);
+        m_menus.remove(node->menu);
+        // submenu models belong to their parent model, drop them with the item
+        if (node != m_root) {
+            node->menu->deleteLater();
+        }
+    }
+
+    m_nodes.remove(node->id);
+    m_layoutChanged.remove(node->id);
+    m_propertiesChanged.remove(node->id);
+    delete node;
+}
+
+/*
+ * Starts tracking the submenu of @node. Returns true if it was not
+ * tracked before, the children known so far are added right away.
+ */
+bool GtkMenuExporter::loadSubmenu(Node *node)
+{
+    if (node->menu || !node->parent || !node->parent->menu) {
+        return false;
+    }
+
+    UnityMenuModel *menu = qobject_cast<UnityMenuModel *>(node->parent->menu->submenu(rowOf(node)));
+    if (!menu) {
+        return false;
+    }
+
+    watchMenu(menu, node);
+
+    const int count = menu->rowCount();
+    node->children.reserve(count);
+    for (int row = 0; row < count; row++) {
+        Node *child = createNode(node);
+        child->properties = propertiesFor(menu, row);
+        node->children << child;
+    }
+    return true;
+}
+
+void GtkMenuExporter::watchMenu(UnityMenuModel *menu, Node *node)
+{
+    node->menu = menu;
+    m_menus.insert(menu, node);
+
+    connect(menu, &QAbstractItemModel::rowsInserted, this, &GtkMenuExporter::slotRowsInserted);
+    connect(menu, &QAbstractItemModel::rowsRemoved, this, &GtkMenuExporter::slotRowsRemoved);
+    connect(menu, &QAbstractItemModel::dataChanged, this, &GtkMenuExporter::slotDataChanged);
+    connect(menu, &QAbstractItemModel::modelReset, this, &GtkMenuExporter::slotModelReset);
+}
+
+int GtkMenuExporter::rowOf(Node *node) const
+{
+    return node->parent ? node->parent->children.indexOf(node) : -1;
+}
+
+/*
+ * Reads @row of @menu as dbusmenu properties. Properties at their
+ * default value are left out, as the specification allows.
+ */
+QVariantMap GtkMenuExporter::propertiesFor(UnityMenuModel *menu, int row) const
+{
+    QVariantMap properties;
+    const QModelIndex index = menu->index(row, 0);
+
+    // hidden-when items stay in the model, clients hide them
+    if (!menu->data(index, roleOf(menu, "isVisible")).toBool()) {
+        properties.insert(QStringLiteral("visible"), false);
+    }
+
+    if (menu->data(index, roleOf(menu, "isSeparator")).toBool()) {
+        properties.insert(QStringLiteral("type"), QStringLiteral("separator"));
+        return properties;
+    }
+
+    // dbusmenu labels use the same '_' mnemonics as GMenuModel
+    const QString label = menu->data(index, roleOf(menu, "label")).toString();
+    if (!label.isEmpty()) {
+        properties.insert(QStringLiteral("label"), label);
+    }
+
+    if (!menu->data(index, roleOf(menu, "sensitive")).toBool()) {
+        properties.insert(QStringLiteral("enabled"), false);
+    }
+
+    const bool isCheck = menu->data(index, roleOf(menu, "isCheck")).toBool();
+    const bool isRadio = menu->data(index, roleOf(menu, "isRadio")).toBool();
+    if (isCheck || isRadio) {
+        properties.insert(QStringLiteral("toggle-type"), isCheck ? QStringLiteral("checkmark") : QStringLiteral("radio"));
+        properties.insert(QStringLiteral("toggle-state"), menu->data(index, roleOf(menu, "isToggled")).toBool() ? 1 : 0);
+    }
+
+    const QString icon = menu->data(index, roleOf(menu, "icon")).toString();
+    if (icon.startsWith(s_themeIconPrefix)) {
+        properties.insert(QStringLiteral("icon-name"), icon.mid(s_themeIconPrefix.length()));
+    }
+
+    const QKeySequence shortcut = menu->data(index, roleOf(menu, "shortcut")).value<QKeySequence>();
+    if (!shortcut.isEmpty()) {
+        properties.insert(QStringLiteral("shortcut"), QVariant::fromValue(DBusMenuShortcut::fromKeySequence(shortcut)));
+    }
+
+    if (menu->data(index, roleOf(menu, "hasSubmenu")).toBool()) {
+        properties.insert(QStringLiteral("children-display"), QStringLiteral("submenu"));
+    }
+
+    return properties;
+}
+
+void GtkMenuExporter::updateProperties(Node *node, const QVariantMap &properties)
+{
+    bool relayout = false;
+
+    for (auto it = properties.constBegin(); it != properties.constEnd(); ++it) {
+        auto old = node->properties.constFind(it.key());
+        if (old != node->properties.constEnd() && sameValue(it.key(), old.value(), it.value())) {
+            continue;
+        }
+        relayout |= isStructuralProperty(it.key());
+        node->updated.insert(it.key());
+        node->removed.remove(it.key());
+    }
+
+    for (auto it = node->properties.constBegin(); it != node->properties.constEnd(); ++it) {
+        if (properties.contains(it.key())) {
+            continue;
+        }
+        relayout |= isStructuralProperty(it.key());
+        node->removed.insert(it.key());
+        node->updated.remove(it.key());
+    }
+
+    node->properties = properties;
+
+    if (relayout) {
+        layoutChanged(node->parent);
+    }
+    if (!node->updated.isEmpty() || !node->removed.isEmpty()) {
+        propertiesChanged(node);
+    }
+}
+
+void GtkMenuExporter::fillLayoutItem(Node *node, int depth, const QStringList &propertyNames, DBusMenuLayoutItem &item) const
+{
+    item.id = node->id;
+
+    if (propertyNames.isEmpty()) {
+        item.properties = node->properties;
+    } else {
+        for (const QString &name : propertyNames) {
+            auto it = node->properties.constFind(name);
+            if (it != node->properties.constEnd()) {
+                item.properties.insert(name, it.value());
+            }
+        }
+    }
+
+    if (depth == 0) {
+        return;
+    }
+
+    item.children.reserve(node->children.count());
+    for (Node *child : node->children) {
+        DBusMenuLayoutItem childItem;
+        fillLayoutItem(child, depth > 0 ? depth - 1 : depth, propertyNames, childItem);
+        item.children << childItem;
+    }
+}
+
+void GtkMenuExporter::layoutChanged(Node *node)
+{
+    m_layoutChanged.insert(node->id);
+    scheduleFlush();
+}
+
+void GtkMenuExporter::propertiesChanged(Node *node)
+{
+    m_propertiesChanged.insert(node->id);
+    scheduleFlush();
+}
+
+void GtkMenuExporter::scheduleFlush()
+{
+    if (!m_flushTimer->isActive()) {
+        m_flushTimer->start();
+    }
+}
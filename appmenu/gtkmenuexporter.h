@@ -0,0 +1,131 @@
+/*
+  This file is part of the KDE project.
+
+  Permission is hereby granted, free of charge, to any person obtaining a
+  copy of this software and associated documentation files (the "Software"),
+  to deal in the Software without restriction, including without limitation
+  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+  and/or sell copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+  DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef GTKMENUEXPORTER_H
+#define GTKMENUEXPORTER_H
+
+// Qt
+#include <QDBusObjectPath>
+#include <QDBusVariant>
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QVector>
+
+#include "dbusmenutypes_p.h"
+
+class QModelIndex;
+class QTimer;
+class UnityMenuModel;
+
+/**
+ * Exports the GMenuModel menu bar of one GTK window as a
+ * com.canonical.dbusmenu object, so dbusmenu clients can show it.
+ *
+ * The menu is read through UnityMenuModel and mirrored in a tree of
+ * nodes holding the dbusmenu properties of each item. Items keep their
+ * id for as long as they exist, GetLayout() and the property getters
+ * answer from the tree, and changes are collected and sent once per
+ * event loop turn: one LayoutUpdated per changed subtree and a single
+ * ItemsPropertiesUpdated carrying only the changed properties.
+ */
+class GtkMenuExporter : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(uint Version READ version)
+    Q_PROPERTY(QString Status READ status)
+
+public:
+    /**
+     * Tracks the menu bar at @p menuBarPath of @p service, resolving its
+     * actions in @p actionGroupPaths (prefix to object path)
+     */
+    GtkMenuExporter(const QString &service, const QString &menuBarPath,
+                    const QHash<QString, QString> &actionGroupPaths, QObject *parent = nullptr);
+    ~GtkMenuExporter() override;
+
+    bool registerOnBus(const QDBusObjectPath &path);
+    QDBusObjectPath objectPath() const { return m_objectPath; }
+
+    uint version() const;
+    QString status() const;
+
+public Q_SLOTS:
+    // com.canonical.dbusmenu
+    void Event(int id, const QString &eventId, const QDBusVariant &data, uint timestamp);
+    QDBusVariant GetProperty(int id, const QString &property);
+    uint GetLayout(int parentId, int recursionDepth, const QStringList &propertyNames, DBusMenuLayoutItem &item);
+    DBusMenuItemList GetGroupProperties(const QList<int> &ids, const QStringList &propertyNames);
+    bool AboutToShow(int id);
+
+Q_SIGNALS:
+    void ItemsPropertiesUpdated(const DBusMenuItemList &updatedProps, const DBusMenuItemKeysList &removedProps);
+    void LayoutUpdated(uint revision, int parentId);
+    void ItemActivationRequested(int id, uint timeStamp);
+
+private Q_SLOTS:
+    void slotRowsInserted(const QModelIndex &parent, int first, int last);
+    void slotRowsRemoved(const QModelIndex &parent, int first, int last);
+    void slotDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight, const QVector<int> &roles);
+    void slotModelReset();
+    void flush();
+
+private:
+    struct Node
+    {
+        int id;
+        Node *parent;
+        UnityMenuModel *menu; // lists the children, nullptr until loaded
+        QVariantMap properties;
+        QVector<Node *> children;
+        QSet<QString> updated;
+        QSet<QString> removed;
+    };
+
+    Node *createNode(Node *parent);
+    void destroyNode(Node *node);
+    bool loadSubmenu(Node *node);
+    void watchMenu(UnityMenuModel *menu, Node *node);
+    int rowOf(Node *node) const;
+
+    QVariantMap propertiesFor(UnityMenuModel *menu, int row) const;
+    void updateProperties(Node *node, const QVariantMap &properties);
+    void fillLayoutItem(Node *node, int depth, const QStringList &propertyNames, DBusMenuLayoutItem &item) const;
+
+    void layoutChanged(Node *node);
+    void propertiesChanged(Node *node);
+    void scheduleFlush();
+
+    Node *m_root;
+    QHash<int, Node *> m_nodes;
+    QHash<UnityMenuModel *, Node *> m_menus;
+    int m_nextId = 1;
+    uint m_revision = 1;
+
+    QSet<int> m_layoutChanged;
+    QSet<int> m_propertiesChanged;
+    QTimer *m_flushTimer;
+
+    QDBusObjectPath m_objectPath;
+};
+
+#endif /* GTKMENUEXPORTER_H */
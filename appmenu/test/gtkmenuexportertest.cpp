@@ -0,0 +1,283 @@
+/*
+  This file is part of the KDE project.
+
+  Permission is hereby granted, free of charge, to any person obtaining a
+  copy of this software and associated documentation files (the "Software"),
+  to deal in the Software without restriction, including without limitation
+  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+  and/or sell copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+  DEALINGS IN THE SOFTWARE.
+*/
+
+extern "C" {
+#include <gio/gio.h>
+}
+
+#include "gtkmenuexporter.h"
+#include "dbusmenushortcut_p.h"
+
+#include <QKeySequence>
+#include <QSet>
+#include <QSignalSpy>
+#include <QtTest>
+
+#include <algorithm>
+
+static const char s_busName[] = "org.kde.appmenu.test";
+static const char s_menuPath[] = "/org/kde/appmenu/test/menus/menubar";
+static const char s_actionsPath[] = "/org/kde/appmenu/test/actions";
+
+/*
+ * Exports a GTK style menu bar (a GMenu and a GSimpleActionGroup) on a
+ * private session bus and checks what GtkMenuExporter makes of it and of
+ * later changes: stable ids, layout revisions and minimal property diffs.
+ */
+class GtkMenuExporterTest : public QObject
+{
+    Q_OBJECT
+
+private:
+    GTestDBus *m_bus;
+    GDBusConnection *m_connection;
+    guint m_ownerId;
+
+    GMenu *m_menu;
+    GMenu *m_file;
+    GSimpleActionGroup *m_actions;
+    guint m_menuExportId;
+    guint m_actionsExportId;
+    GtkMenuExporter *m_exporter;
+    int m_fileId;
+
+    DBusMenuLayoutItem layout(int id, uint *revision = nullptr)
+    {
+        DBusMenuLayoutItem item;
+        const uint r = m_exporter->GetLayout(id, 1, QStringList(), item);
+        if (revision) {
+            *revision = r;
+        }
+        return item;
+    }
+
+    QList<int> childIds(int id)
+    {
+        QList<int> ids;
+        const DBusMenuLayoutItem item = layout(id);
+        for (const DBusMenuLayoutItem &child : item.children) {
+            ids << child.id;
+        }
+        return ids;
+    }
+
+    QVariantMap childProperties(int id, int row)
+    {
+        const DBusMenuLayoutItem item = layout(id);
+        return row < item.children.count() ? item.children.at(row).properties : QVariantMap();
+    }
+
+    void addAction(GAction *action)
+    {
+        g_action_map_add_action(G_ACTION_MAP(m_actions), action);
+        g_object_unref(action);
+    }
+
+    void setEnabled(const char *name, bool enabled)
+    {
+        GAction *action = g_action_map_lookup_action(G_ACTION_MAP(m_actions), name);
+        g_simple_action_set_enabled(G_SIMPLE_ACTION(action), enabled);
+    }
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+        m_bus = g_test_dbus_new(G_TEST_DBUS_NONE);
+        g_test_dbus_up(m_bus);
+
+        m_connection = g_bus_get_sync(G_BUS_TYPE_SESSION, NULL, NULL);
+        QVERIFY(m_connection);
+
+        m_ownerId = g_bus_own_name_on_connection(m_connection, s_busName, G_BUS_NAME_OWNER_FLAGS_NONE,
+                                                 NULL, NULL, NULL, NULL);
+    }
+
+    void cleanupTestCase()
+    {
+        g_bus_unown_name(m_ownerId);
+        g_object_unref(m_connection);
+
+        g_test_dbus_down(m_bus);
+        g_object_unref(m_bus);
+    }
+
+    void init()
+    {
+        m_actions = g_simple_action_group_new();
+        addAction(G_ACTION(g_simple_action_new("save", NULL)));
+        addAction(G_ACTION(g_simple_action_new_stateful("bold", NULL, g_variant_new_boolean(FALSE))));
+        addAction(G_ACTION(g_simple_action_new("print", NULL)));
+
+        m_file = g_menu_new();
+        GMenuItem *save = g_menu_item_new("_Save", "app.save");
+        g_menu_item_set_attribute(save, "accel", "s", "<Primary>s");
+        g_menu_append_item(m_file, save);
+        g_object_unref(save);
+        g_menu_append(m_file, "_Bold", "app.bold");
+        GMenuItem *print = g_menu_item_new("_Print", "app.print");
+        g_menu_item_set_attribute(print, "hidden-when", "s", "action-disabled");
+        g_menu_append_item(m_file, print);
+        g_object_unref(print);
+
+        m_menu = g_menu_new();
+        g_menu_append_submenu(m_menu, "_File", G_MENU_MODEL(m_file));
+
+        m_menuExportId = g_dbus_connection_export_menu_model(m_connection, s_menuPath, G_MENU_MODEL(m_menu), NULL);
+        m_actionsExportId = g_dbus_connection_export_action_group(m_connection, s_actionsPath, G_ACTION_GROUP(m_actions), NULL);
+        QVERIFY(m_menuExportId != 0);
+        QVERIFY(m_actionsExportId != 0);
+
+        QHash<QString, QString> actionGroupPaths;
+        actionGroupPaths.insert(QStringLiteral("app"), QString::fromLatin1(s_actionsPath));
+        m_exporter = new GtkMenuExporter(QString::fromLatin1(s_busName), QString::fromLatin1(s_menuPath), actionGroupPaths);
+
+        QTRY_COMPARE(layout(0).children.count(), 1);
+        m_fileId = layout(0).children.at(0).id;
+
+        m_exporter->AboutToShow(m_fileId);
+        QTRY_COMPARE(layout(m_fileId).children.count(), 3);
+
+        // the action group arrives separately from the menu
+        QTRY_COMPARE(childProperties(m_fileId, 1).value(QStringLiteral("toggle-type")).toString(), QStringLiteral("checkmark"));
+        QTRY_VERIFY(!childProperties(m_fileId, 0).contains(QStringLiteral("enabled")));
+
+        // let the initial changes go out before the tests watch the signals
+        QTest::qWait(50);
+    }
+
+    void cleanup()
+    {
+        delete m_exporter;
+
+        g_dbus_connection_unexport_menu_model(m_connection, m_menuExportId);
+        g_dbus_connection_unexport_action_group(m_connection, m_actionsExportId);
+        g_object_unref(m_menu);
+        g_object_unref(m_file);
+        g_object_unref(m_actions);
+    }
+
+    void initialLayout()
+    {
+        const QVariantMap file = layout(0).children.at(0).properties;
+        QCOMPARE(file.value(QStringLiteral("label")).toString(), QStringLiteral("_File"));
+        QCOMPARE(file.value(QStringLiteral("children-display")).toString(), QStringLiteral("submenu"));
+
+        const QVariantMap save = childProperties(m_fileId, 0);
+        QCOMPARE(save.value(QStringLiteral("label")).toString(), QStringLiteral("_Save"));
+        QCOMPARE(save.value(QStringLiteral("shortcut")).value<DBusMenuShortcut>(),
+                 DBusMenuShortcut::fromKeySequence(QKeySequence(QStringLiteral("Ctrl+S"))));
+        QVERIFY(!save.contains(QStringLiteral("visible")));
+
+        const QVariantMap bold = childProperties(m_fileId, 1);
+        QCOMPARE(bold.value(QStringLiteral("toggle-state")).toInt(), 0);
+
+        const QList<int> ids = childIds(m_fileId);
+        QCOMPARE(ids.toSet().count(), 3);
+        QVERIFY(!ids.contains(0));
+        QVERIFY(!ids.contains(m_fileId));
+    }
+
+    /*
+     * An inserted item gets a fresh id, the others keep theirs, and the
+     * parent's layout is announced once with a newer revision.
+     */
+    void insertKeepsIdsAndBumpsRevision()
+    {
+        uint revision;
+        layout(m_fileId, &revision);
+        const QList<int> before = childIds(m_fileId);
+
+        QSignalSpy layoutSpy(m_exporter, &GtkMenuExporter::LayoutUpdated);
+        g_menu_insert(m_file, 1, "_Open", "app.save");
+
+        QTRY_COMPARE(layoutSpy.count(), 1);
+        QVERIFY(layoutSpy.at(0).at(0).toUInt() > revision);
+        QCOMPARE(layoutSpy.at(0).at(1).toInt(), m_fileId);
+
+        const QList<int> after = childIds(m_fileId);
+        QCOMPARE(after.count(), 4);
+        QCOMPARE(after.at(0), before.at(0));
+        QCOMPARE(after.at(2), before.at(1));
+        QCOMPARE(after.at(3), before.at(2));
+        QVERIFY(!before.contains(after.at(1)));
+        QVERIFY(after.at(1) > std::max(m_fileId, *std::max_element(before.constBegin(), before.constEnd())));
+    }
+
+    /*
+     * A state change sends only the property that changed, for the one
+     * item it changed on, and no layout update.
+     */
+    void stateChangeSendsOnlyTheDiff()
+    {
+        const int boldId = childIds(m_fileId).at(1);
+
+        QSignalSpy layoutSpy(m_exporter, &GtkMenuExporter::LayoutUpdated);
+        QSignalSpy propertiesSpy(m_exporter, &GtkMenuExporter::ItemsPropertiesUpdated);
+        g_action_group_change_action_state(G_ACTION_GROUP(m_actions), "bold", g_variant_new_boolean(TRUE));
+
+        QTRY_COMPARE(propertiesSpy.count(), 1);
+        const DBusMenuItemList updated = qvariant_cast<DBusMenuItemList>(propertiesSpy.at(0).at(0));
+        const DBusMenuItemKeysList removed = qvariant_cast<DBusMenuItemKeysList>(propertiesSpy.at(0).at(1));
+
+        QCOMPARE(updated.count(), 1);
+        QCOMPARE(updated.at(0).id, boldId);
+        QCOMPARE(updated.at(0).properties.keys(), QStringList() << QStringLiteral("toggle-state"));
+        QCOMPARE(updated.at(0).properties.value(QStringLiteral("toggle-state")).toInt(), 1);
+        QVERIFY(removed.isEmpty());
+        QCOMPARE(layoutSpy.count(), 0);
+    }
+
+    /*
+     * Disabling an action exports enabled=false, and visible=false for an
+     * item hidden when its action is disabled. Enabling it again removes
+     * both properties.
+     */
+    void hiddenWhenDisabled()
+    {
+        const int printId = childIds(m_fileId).at(2);
+
+        QSignalSpy propertiesSpy(m_exporter, &GtkMenuExporter::ItemsPropertiesUpdated);
+        setEnabled("print", false);
+
+        QTRY_COMPARE(propertiesSpy.count(), 1);
+        DBusMenuItemList updated = qvariant_cast<DBusMenuItemList>(propertiesSpy.at(0).at(0));
+        QCOMPARE(updated.count(), 1);
+        QCOMPARE(updated.at(0).id, printId);
+        QCOMPARE(updated.at(0).properties.value(QStringLiteral("enabled")), QVariant(false));
+        QCOMPARE(updated.at(0).properties.value(QStringLiteral("visible")), QVariant(false));
+
+        setEnabled("print", true);
+
+        QTRY_COMPARE(propertiesSpy.count(), 2);
+        updated = qvariant_cast<DBusMenuItemList>(propertiesSpy.at(1).at(0));
+        const DBusMenuItemKeysList removed = qvariant_cast<DBusMenuItemKeysList>(propertiesSpy.at(1).at(1));
+        QVERIFY(updated.isEmpty());
+        QCOMPARE(removed.count(), 1);
+        QCOMPARE(removed.at(0).id, printId);
+        QCOMPARE(removed.at(0).properties.toSet(),
+                 QSet<QString>() << QStringLiteral("enabled") << QStringLiteral("visible"));
+    }
+};
+
+QTEST_GUILESS_MAIN(GtkMenuExporterTest)
+
+#include "gtkmenuexportertest.moc"
@@ -0,0 +1,95 @@
+/*
+  This file is part of the KDE project.
+
+  Permission is hereby granted, free of charge, to any person obtaining a
+  copy of this software and associated documentation files (the "Software"),
+  to deal in the Software without restriction, including without limitation
+  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+  and/or sell copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+  DEALINGS IN THE SOFTWARE.
+*/
+
+#include "gtkwindowmenu.h"
+
+#include <config-X11.h>
+
+#if HAVE_X11
+#include <QX11Info>
+#include <xcb/xcb.h>
+#endif
+
+static const QByteArray s_x11GtkUniqueBusNamePropertyName = QByteArrayLiteral("_GTK_UNIQUE_BUS_NAME");
+static const QByteArray s_x11GtkMenuBarObjectPathPropertyName = QByteArrayLiteral("_GTK_MENUBAR_OBJECT_PATH");
+static const QByteArray s_x11GtkApplicationObjectPathPropertyName = QByteArrayLiteral("_GTK_APPLICATION_OBJECT_PATH");
+static const QByteArray s_x11GtkWindowObjectPathPropertyName = QByteArrayLiteral("_GTK_WINDOW_OBJECT_PATH");
+static const QByteArray s_x11UnityObjectPathPropertyName = QByteArrayLiteral("_UNITY_OBJECT_PATH");
+
+QByteArray windowPropertyString(WId id, const QByteArray &name)
+{
+    QByteArray value;
+#if HAVE_X11
+    auto *c = QX11Info::connection();
+    static QHash<QByteArray, xcb_atom_t> s_atoms;
+
+    if (!c) {
+        return value;
+    }
+
+    if (!s_atoms.contains(name)) {
+        const xcb_intern_atom_cookie_t atomCookie = xcb_intern_atom(c, false, name.length(), name.constData());
+        QScopedPointer<xcb_intern_atom_reply_t, QScopedPointerPodDeleter> atomReply(xcb_intern_atom_reply(c, atomCookie, Q_NULLPTR));
+        if (atomReply.isNull()) {
+            return value;
+        }
+        s_atoms[name] = atomReply->atom;
+    }
+    if (s_atoms[name] == XCB_ATOM_NONE) {
+        return value;
+    }
+
+    static const long MAX_PROP_SIZE = 10000;
+    auto propertyCookie = xcb_get_property(c, false, id, s_atoms[name], XCB_GET_PROPERTY_TYPE_ANY, 0, MAX_PROP_SIZE);
+    QScopedPointer<xcb_get_property_reply_t, QScopedPointerPodDeleter> propertyReply(xcb_get_property_reply(c, propertyCookie, NULL));
+    if (propertyReply.isNull()) {
+        return value;
+    }
+
+    if (propertyReply->type != XCB_ATOM_NONE && propertyReply->format == 8 && propertyReply->value_len > 0) {
+        const char *data = (const char *) xcb_get_property_value(propertyReply.data());
+        int len = propertyReply->value_len;
+        if (data) {
+            value = QByteArray(data, data[len - 1] ? len : len - 1);
+        }
+    }
+#else
+    Q_UNUSED(id);
+    Q_UNUSED(name);
+#endif
+    return value;
+}
+
+GtkWindowMenu GtkWindowMenu::fromWindow(WId id)
+{
+    GtkWindowMenu menu;
+    menu.serviceName = QString::fromUtf8(windowPropertyString(id, s_x11GtkUniqueBusNamePropertyName));
+    menu.menuBarObjectPath = QString::fromUtf8(windowPropertyString(id, s_x11GtkMenuBarObjectPathPropertyName));
+    if (!menu.isValid()) {
+        return GtkWindowMenu();
+    }
+
+    menu.actionGroupPaths[QStringLiteral("app")] = QString::fromUtf8(windowPropertyString(id, s_x11GtkApplicationObjectPathPropertyName));
+    menu.actionGroupPaths[QStringLiteral("win")] = QString::fromUtf8(windowPropertyString(id, s_x11GtkWindowObjectPathPropertyName));
+    menu.actionGroupPaths[QStringLiteral("unity")] = QString::fromUtf8(windowPropertyString(id, s_x11UnityObjectPathPropertyName));
+    return menu;
+}
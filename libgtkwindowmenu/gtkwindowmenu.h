@@ -0,0 +1,62 @@
+/*
+  This file is part of the KDE project.
+
+  Permission is hereby granted, free of charge, to any person obtaining a
+  copy of this software and associated documentation files (the "Software"),
+  to deal in the Software without restriction, including without limitation
+  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+  and/or sell copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+  DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef GTKWINDOWMENU_H
+#define GTKWINDOWMENU_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <qwindowdefs.h>
+
+/**
+ * The menu bar a GTK application announces on one of its X11 windows:
+ * the GMenuModel and the action groups its items refer to.
+ */
+struct GtkWindowMenu
+{
+    /** _GTK_UNIQUE_BUS_NAME, the connection exporting the menu */
+    QString serviceName;
+    /** _GTK_MENUBAR_OBJECT_PATH */
+    QString menuBarObjectPath;
+    /** Object path per action prefix: "app", "win" and "unity" */
+    QHash<QString, QString> actionGroupPaths;
+
+    bool isValid() const
+    {
+        return !serviceName.isEmpty() && !menuBarObjectPath.isEmpty();
+    }
+
+    /**
+     * Reads the GTK menu properties of window @p id. The result is not
+     * valid if the window has none or X11 is not available.
+     */
+    static GtkWindowMenu fromWindow(WId id);
+};
+
+/**
+ * Reads the STRING or UTF8_STRING property @p name of the X11 window @p id.
+ * GTK sets its properties as UTF8_STRING, KDE ones are STRING.
+ */
+QByteArray windowPropertyString(WId id, const QByteArray &name);
+
+#endif /* GTKWINDOWMENU_H */
@@ -0,0 +1,125 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+extern "C" {
+#include <glib.h>
+#include <string.h>
+}
+
+#include "accelparser.h"
+
+#include <QKeySequence>
+#include <QString>
+
+/*! \internal
+    GDK key names that differ from the ones QKeySequence understands.
+*/
+static const struct {
+    const char *gdk;
+    const char *qt;
+} keyNames[] = {
+    { "plus",        "+" },
+    { "minus",       "-" },
+    { "equal",       "=" },
+    { "comma",       "," },
+    { "period",      "." },
+    { "slash",       "/" },
+    { "backslash",   "\\" },
+    { "space",       "Space" },
+    { "Page_Up",     "PgUp" },
+    { "Page_Down",   "PgDown" },
+    { "Escape",      "Esc" },
+    { "BackSpace",   "Backspace" },
+    { "KP_Add",      "+" },
+    { "KP_Subtract", "-" }
+};
+
+/*! \internal
+    Returns the portable text for the modifier between the angle brackets,
+    or NULL for one Qt has no equivalent of.
+*/
+static const char *modifierText(const char *name, gsize length)
+{
+    static const struct {
+        const char *gdk;
+        const char *qt;
+    } modifiers[] = {
+        { "primary", "Ctrl+" },
+        { "control", "Ctrl+" },
+        { "ctrl",    "Ctrl+" },
+        { "ctl",     "Ctrl+" },
+        { "shift",   "Shift+" },
+        { "shft",    "Shift+" },
+        { "alt",     "Alt+" },
+        { "mod1",    "Alt+" },
+        { "super",   "Meta+" },
+        { "meta",    "Meta+" }
+    };
+
+    for (uint i = 0; i < G_N_ELEMENTS (modifiers); i++) {
+        if (strlen (modifiers[i].gdk) == length && g_ascii_strncasecmp (name, modifiers[i].gdk, length) == 0)
+            return modifiers[i].qt;
+    }
+    return NULL;
+}
+
+/*!
+    Returns the QKeySequence for the GTK accelerator \a accel, or an empty
+    one if \a accel is NULL, has no key, or uses a modifier or key Qt cannot
+    express: "<Hyper>a" must not turn into a plain "A" shortcut.
+*/
+QKeySequence AccelParser::toKeySequence(const char *accel)
+{
+    QString text;
+    const char *p = accel;
+
+    if (accel == NULL || *accel == '\0')
+        return QKeySequence();
+
+    while (*p == '<') {
+        const char *end = strchr (p, '>');
+        const char *modifier;
+
+        if (end == NULL)
+            return QKeySequence();
+
+        modifier = modifierText (p + 1, end - p - 1);
+        if (modifier == NULL)
+            return QKeySequence();
+
+        text += QLatin1String(modifier);
+        p = end + 1;
+    }
+
+    if (*p == '\0')
+        return QKeySequence();
+
+    const char *key = NULL;
+    for (uint i = 0; i < G_N_ELEMENTS (keyNames) && key == NULL; i++) {
+        if (strcmp (p, keyNames[i].gdk) == 0)
+            key = keyNames[i].qt;
+    }
+
+    if (key)
+        text += QLatin1String(key);
+    else if (p[1] == '\0')
+        text += QChar(g_ascii_toupper (*p));
+    else
+        text += QString::fromUtf8(p);
+
+    QKeySequence sequence = QKeySequence::fromString(text, QKeySequence::PortableText);
+    if (sequence.count() != 1 || (sequence[0] & ~Qt::KeyboardModifierMask) == Qt::Key_unknown)
+        return QKeySequence();
+    return sequence;
+}
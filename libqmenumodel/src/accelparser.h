@@ -0,0 +1,30 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ACCELPARSER_H
+#define ACCELPARSER_H
+
+class QKeySequence;
+
+// Converts the GTK accelerators found in a menu item's "accel" attribute
+// ("<Primary><Shift>s", "<Alt>F4") to QKeySequences. QKeySequence cannot
+// parse them itself: the modifiers are spelled differently and the key
+// names follow GDK.
+class AccelParser
+{
+public:
+    static QKeySequence toKeySequence(const char *accel);
+};
+
+#endif // ACCELPARSER_H
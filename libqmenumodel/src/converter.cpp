@@ -23,10 +23,28 @@ extern "C" {
 }
 
 #include "converter.h"
+#include "gbytesref.h"
+#include "stringcache.h"
 
 #include <QDebug>
+#include <QHash>
+#include <QMutex>
 #include <QString>
 #include <QVariant>
+#include <QVector>
+
+/*! \internal
+    Converts \a bytes to an 'ay' value. Data without any nul is a C string
+    and gets its terminator back; anything else is binary data and keeps its
+    exact length, so 'ay' values survive toQVariant() and back unchanged.
+*/
+static GVariant *toByteString(const QByteArray &bytes)
+{
+    if (!bytes.contains('\0')) {
+        return g_variant_new_bytestring(bytes.constData());
+    }
+    return g_variant_new_fixed_array(G_VARIANT_TYPE_BYTE, bytes.constData(), bytes.size(), 1);
+}
 
 /*! \internal */
 QVariant Converter::toQVariant(GVariant *value)
@@ -69,7 +87,10 @@ QVariant Converter::toQVariant(GVariant *value)
         result.setValue(list);
         g_free(sa);
     } else if (g_variant_type_equal(type, G_VARIANT_TYPE_BYTESTRING)) {
-        result.setValue(QByteArray(g_variant_get_bytestring(value)));
+        // QML and type() checks expect a plain byte array here; callers
+        // that can handle GBytesRef get the buffer uncopied from
+        // GBytesRef::fromVariant() instead. Only a C string loses its nul.
+        result.setValue(GBytesRef::fromVariant(value).toByteArray());
     } else if (g_variant_type_equal(type, G_VARIANT_TYPE_BYTESTRING_ARRAY)) {
         gsize size = 0;
         const gchar **bsa = g_variant_get_bytestring_array(value, &size);
@@ -92,7 +113,7 @@ QVariant Converter::toQVariant(GVariant *value)
         g_variant_iter_init (&iter, value);
         while (g_variant_iter_loop (&iter, "{sv}", &key, &vvalue))
         {
-            qmap.insert(QString::fromUtf8(key), toQVariant(vvalue));
+            qmap.insert(StringCache::intern(key), toQVariant(vvalue));
         }
 
         result.setValue(qmap);
@@ -171,7 +192,7 @@ GVariant* Converter::toGVariant(const QVariant &value)
         result = g_variant_new_boolean(value.toBool());
         break;
     case QVariant::ByteArray:
-        result = g_variant_new_bytestring(value.toByteArray());
+        result = toByteString(value.toByteArray());
         break;
     case QVariant::Double:
         result = g_variant_new_double(value.toDouble());
@@ -256,119 +277,214 @@ GVariant* Converter::toGVariant(const QVariant &value)
         break;
     }
     default:
-        qWarning() << "QVariant type not supported:" << value.type();
+        if (value.userType() == qMetaTypeId<GBytesRef>()) {
+            result = value.value<GBytesRef>().toGVariant();
+        } else {
+            qWarning() << "QVariant type not supported:" << value.type();
+        }
     }
 
     return result;
 }
 
-GVariant* Converter::toGVariantWithSchema(const QVariant &value, const char* schema)
+/*! \internal
+    A conversion plan compiled from a GVariant type string.
+
+    Parsing the schema and classifying its type happens once per distinct
+    schema; converting a value then only walks this tree.
+*/
+class SchemaPlan
 {
-    if (!g_variant_type_string_is_valid(schema)) {
-        return Converter::toGVariant(value);
+public:
+    enum Kind {
+        Unsupported,
+        Boolean,
+        Byte,
+        Int16,
+        UInt16,
+        Int32,
+        UInt32,
+        Int64,
+        UInt64,
+        Double,
+        String,
+        Variant,
+        VarDict,
+        ByteString,
+        Dictionary,
+        Array,
+        Tuple
+    };
+
+    SchemaPlan(const GVariantType *type);
+    ~SchemaPlan();
+
+    GVariant *convert(const QVariant &value) const;
+    GVariant *convertMap(const QVariantMap &map) const;
+
+    Kind kind;
+    GVariantType *type;
+    QVector<SchemaPlan*> children;
+
+private:
+    GVariant *convertList(const QVariantList &list) const;
+    GVariant *convertTuple(const QVariantList &list) const;
+
+    Q_DISABLE_COPY(SchemaPlan)
+};
+
+SchemaPlan::SchemaPlan(const GVariantType *_type)
+    : kind(Unsupported),
+      type(g_variant_type_copy(_type))
+{
+    if (g_variant_type_equal(type, G_VARIANT_TYPE_BOOLEAN)) {
+        kind = Boolean;
+    } else if (g_variant_type_equal(type, G_VARIANT_TYPE_BYTE)) {
+        kind = Byte;
+    } else if (g_variant_type_equal(type, G_VARIANT_TYPE_INT16)) {
+        kind = Int16;
+    } else if (g_variant_type_equal(type, G_VARIANT_TYPE_UINT16)) {
+        kind = UInt16;
+    } else if (g_variant_type_equal(type, G_VARIANT_TYPE_INT32)) {
+        kind = Int32;
+    } else if (g_variant_type_equal(type, G_VARIANT_TYPE_UINT32)) {
+        kind = UInt32;
+    } else if (g_variant_type_equal(type, G_VARIANT_TYPE_INT64)) {
+        kind = Int64;
+    } else if (g_variant_type_equal(type, G_VARIANT_TYPE_UINT64)) {
+        kind = UInt64;
+    } else if (g_variant_type_equal(type, G_VARIANT_TYPE_DOUBLE)) {
+        kind = Double;
+    } else if (g_variant_type_equal(type, G_VARIANT_TYPE_STRING)) {
+        kind = String;
+    } else if (g_variant_type_equal(type, G_VARIANT_TYPE_VARIANT)) {
+        kind = Variant;
+    } else if (g_variant_type_equal(type, G_VARIANT_TYPE_VARDICT)) {
+        kind = VarDict;
+    } else if (g_variant_type_equal(type, G_VARIANT_TYPE_BYTESTRING)) {
+        // byte arrays go out whole; lists of numbers byte by byte
+        kind = ByteString;
+        children << new SchemaPlan(G_VARIANT_TYPE_BYTE);
+    } else if (g_variant_type_is_array(type)) {
+        const GVariantType *element = g_variant_type_element(type);
+        if (g_variant_type_is_dict_entry(element) &&
+            g_variant_type_equal(g_variant_type_key(element), G_VARIANT_TYPE_STRING)) {
+            kind = Dictionary;
+            children << new SchemaPlan(g_variant_type_value(element));
+        } else {
+            kind = Array;
+        }
+        // arrays of dict entries still accept lists, entry by entry
+        children.prepend(new SchemaPlan(element));
+    } else if (g_variant_type_is_tuple(type)) {
+        kind = Tuple;
+        for (const GVariantType *entry = g_variant_type_first(type);
+             entry != NULL;
+             entry = g_variant_type_next(entry)) {
+            children << new SchemaPlan(entry);
+        }
     }
+}
+
+SchemaPlan::~SchemaPlan()
+{
+    qDeleteAll(children);
+    g_variant_type_free(type);
+}
 
-    GVariant* result = NULL;
-    GVariantType* schema_type = g_variant_type_new(schema);
+GVariant *SchemaPlan::convert(const QVariant &value) const
+{
+    GVariant *result = NULL;
 
-    if (g_variant_type_equal(schema_type, G_VARIANT_TYPE_BOOLEAN)) {
+    switch (kind) {
+    case Boolean:
         if (value.canConvert<bool>()) {
-            result = g_variant_new_boolean (value.value<bool>());
+            result = g_variant_new_boolean(value.value<bool>());
         }
-    } else if (g_variant_type_equal(schema_type, G_VARIANT_TYPE_BYTE)) {
+        break;
+    case Byte:
         if (value.canConvert<uchar>()) {
-            result = g_variant_new_byte (value.value<uchar>());
+            result = g_variant_new_byte(value.value<uchar>());
         }
-    } else if (g_variant_type_equal(schema_type, G_VARIANT_TYPE_INT16)) {
+        break;
+    case Int16:
         if (value.canConvert<qint16>()) {
-            result = g_variant_new_int16 (value.value<qint16>());
+            result = g_variant_new_int16(value.value<qint16>());
         }
-    } else if (g_variant_type_equal(schema_type, G_VARIANT_TYPE_UINT16)) {
+        break;
+    case UInt16:
         if (value.canConvert<quint16>()) {
-            result = g_variant_new_uint16 (value.value<quint16>());
+            result = g_variant_new_uint16(value.value<quint16>());
         }
-    } else if (g_variant_type_equal(schema_type, G_VARIANT_TYPE_INT32)) {
+        break;
+    case Int32:
         if (value.canConvert<qint32>()) {
-            result = g_variant_new_int32 (value.value<qint32>());
+            result = g_variant_new_int32(value.value<qint32>());
         }
-    } else if (g_variant_type_equal(schema_type, G_VARIANT_TYPE_UINT32)) {
+        break;
+    case UInt32:
         if (value.canConvert<quint32>()) {
-            result = g_variant_new_uint32 (value.value<quint32>());
+            result = g_variant_new_uint32(value.value<quint32>());
         }
-    } else if (g_variant_type_equal(schema_type, G_VARIANT_TYPE_INT64)) {
+        break;
+    case Int64:
         if (value.canConvert<qint64>()) {
-            result = g_variant_new_int64 (value.value<qint64>());
+            result = g_variant_new_int64(value.value<qint64>());
         }
-    } else if (g_variant_type_equal(schema_type, G_VARIANT_TYPE_UINT64)) {
+        break;
+    case UInt64:
         if (value.canConvert<quint64>()) {
-            result = g_variant_new_uint64 (value.value<quint64>());
+            result = g_variant_new_uint64(value.value<quint64>());
         }
-    } else if (g_variant_type_equal(schema_type, G_VARIANT_TYPE_DOUBLE)) {
+        break;
+    case Double:
         if (value.canConvert<double>()) {
-            result = g_variant_new_double (value.value<double>());
+            result = g_variant_new_double(value.value<double>());
         }
-    } else if (g_variant_type_equal(schema_type, G_VARIANT_TYPE_STRING)) {
+        break;
+    case String:
         if (value.canConvert<QString>()) {
             result = g_variant_new_string(qUtf8Printable(value.toString()));
         }
-    } else if (g_variant_type_equal(schema_type, G_VARIANT_TYPE_VARIANT)) {
-        result = g_variant_new_variant(Converter::toGVariant(value));
-    } else if (g_variant_type_equal(schema_type, G_VARIANT_TYPE_VARDICT)) {
+        break;
+    case Variant:
+    {
+        GVariant *inner = Converter::toGVariant(value);
+        if (inner) {
+            result = g_variant_new_variant(inner);
+        }
+        break;
+    }
+    case VarDict:
         if (value.canConvert(QVariant::Map)) {
             result = Converter::toGVariant(value.toMap());
         }
-    } else if (g_variant_type_is_array(schema_type)) {
+        break;
+    case ByteString:
+        if (value.type() == QVariant::ByteArray) {
+            result = toByteString(value.toByteArray());
+        } else if (value.userType() != qMetaTypeId<GBytesRef>() && value.canConvert(QVariant::List)) {
+            result = convertList(value.toList());
+        }
+        break;
+    case Dictionary:
+        if (value.type() == QVariant::Map) {
+            result = convertMap(value.toMap());
+            break;
+        }
+        // fall through
+    case Array:
         if (value.canConvert(QVariant::List)) {
-            const GVariantType* entryType = g_variant_type_element(schema_type);
-            const gchar* entryTypeString = g_variant_type_peek_string(entryType);
-
-            GVariantBuilder *b = g_variant_builder_new(G_VARIANT_TYPE_ARRAY);
-            bool ok = true;
-
-            for (const QVariant &v : value.toList()) {
-                GVariant *data = toGVariantWithSchema(v, entryTypeString);
-
-                if (data) {
-                    g_variant_builder_add_value(b, data);
-                } else {
-                    ok = false;
-                    qWarning() << "Failed to convert list to array with schema:" << schema;
-                    break;
-                }
-            }
-            if (ok) {
-                result = g_variant_builder_end(b);
-            }
-            g_variant_builder_unref(b);
+            result = convertList(value.toList());
         }
-    } else if (g_variant_type_is_tuple(schema_type)) {
+        break;
+    case Tuple:
         if (value.canConvert(QVariant::List)) {
-            const GVariantType* entryType = g_variant_type_first(schema_type);
-
-            GVariantBuilder *b = g_variant_builder_new(G_VARIANT_TYPE_TUPLE);
-            bool ok = true;
-
-            for (const QVariant &v : value.toList()) {
-                gchar* entryTypeString = g_variant_type_dup_string(entryType);
-                GVariant *data = toGVariantWithSchema(v, entryTypeString);
-                g_free(entryTypeString);
-
-                if (data) {
-                    g_variant_builder_add_value(b, data);
-                    entryType = g_variant_type_next(entryType);
-                    if (!entryType)
-                        break;
-                } else {
-                    ok = false;
-                    qWarning() << "Failed to convert list to array with schema:" << schema;
-                    break;
-                }
-            }
-            if (ok) {
-                result = g_variant_builder_end(b);
-            }
-            g_variant_builder_unref(b);
+            result = convertTuple(value.toList());
         }
+        break;
+    case Unsupported:
+        break;
     }
 
     // fallback to straight convert.
@@ -376,8 +492,145 @@ GVariant* Converter::toGVariantWithSchema(const QVariant &value, const char* sch
         result = Converter::toGVariant(value);
     }
 
-    g_free(schema_type);
-
     return result;
 }
 
+/*! \internal
+    Converts every value of \a map with the plan of the dictionary values.
+    Only valid for 'a{s*}' plans.
+*/
+GVariant *SchemaPlan::convertMap(const QVariantMap &map) const
+{
+    if (kind == VarDict) {
+        return Converter::toGVariant(map);
+    } else if (kind != Dictionary) {
+        return NULL;
+    }
+
+    const SchemaPlan *valuePlan = children.at(1);
+    GVariantBuilder b;
+    g_variant_builder_init(&b, type);
+
+    for (QVariantMap::const_iterator it = map.constBegin(); it != map.constEnd(); ++it) {
+        GVariant *data = valuePlan->convert(it.value());
+
+        if (!data || !g_variant_is_of_type(data, valuePlan->type)) {
+            if (data) {
+                g_variant_unref(g_variant_ref_sink(data));
+            }
+            qWarning() << "Failed to convert map entry" << it.key() << "with schema:" << g_variant_type_peek_string(type);
+            g_variant_builder_clear(&b);
+            return NULL;
+        }
+        g_variant_builder_add_value(&b, g_variant_new_dict_entry(g_variant_new_string(qUtf8Printable(it.key())), data));
+    }
+    return g_variant_builder_end(&b);
+}
+
+GVariant *SchemaPlan::convertList(const QVariantList &list) const
+{
+    const SchemaPlan *elementPlan = children.at(0);
+
+    if (list.isEmpty()) {
+        if (g_variant_type_is_definite(elementPlan->type)) {
+            return g_variant_new_array(elementPlan->type, NULL, 0);
+        }
+        return NULL;
+    }
+
+    GVariantBuilder b;
+    g_variant_builder_init(&b, G_VARIANT_TYPE_ARRAY);
+
+    for (const QVariant &v : list) {
+        GVariant *data = elementPlan->convert(v);
+
+        if (data) {
+            g_variant_builder_add_value(&b, data);
+        } else {
+            qWarning() << "Failed to convert list to array with schema:" << g_variant_type_peek_string(type);
+            g_variant_builder_clear(&b);
+            return NULL;
+        }
+    }
+    return g_variant_builder_end(&b);
+}
+
+GVariant *SchemaPlan::convertTuple(const QVariantList &list) const
+{
+    GVariantBuilder b;
+    g_variant_builder_init(&b, G_VARIANT_TYPE_TUPLE);
+
+    const int count = qMin(list.size(), children.size());
+    for (int i = 0; i < count; i++) {
+        GVariant *data = children.at(i)->convert(list.at(i));
+
+        if (data) {
+            g_variant_builder_add_value(&b, data);
+        } else {
+            qWarning() << "Failed to convert list to array with schema:" << g_variant_type_peek_string(type);
+            g_variant_builder_clear(&b);
+            return NULL;
+        }
+    }
+    return g_variant_builder_end(&b);
+}
+
+/*! \internal
+    Compiled plans, one per distinct schema string. Menus only ever use a
+    handful of action parameter and state types, so entries are kept for
+    the lifetime of the library.
+*/
+class SchemaPlanCache
+{
+public:
+    ~SchemaPlanCache()
+    {
+        qDeleteAll(plans);
+    }
+
+    const SchemaPlan *plan(const char *schema)
+    {
+        // no allocation for the lookup itself
+        const QByteArray key = QByteArray::fromRawData(schema, qstrlen(schema));
+
+        QMutexLocker locker(&mutex);
+        const SchemaPlan *plan = plans.value(key);
+        if (plan == NULL) {
+            GVariantType *type = g_variant_type_new(schema);
+            plan = new SchemaPlan(type);
+            g_variant_type_free(type);
+            plans.insert(QByteArray(schema), plan);
+        }
+        return plan;
+    }
+
+private:
+    QMutex mutex;
+    QHash<QByteArray, const SchemaPlan*> plans;
+};
+Q_GLOBAL_STATIC(SchemaPlanCache, schemaPlanCache)
+
+GVariant* Converter::toGVariantWithSchema(const QVariant &value, const char* schema)
+{
+    if (!schema || !g_variant_type_string_is_valid(schema)) {
+        return Converter::toGVariant(value);
+    }
+
+    return schemaPlanCache()->plan(schema)->convert(value);
+}
+
+GVariant* Converter::toGVariantWithSchema(const QVariantMap &values, const char* schema)
+{
+    if (!schema || !g_variant_type_string_is_valid(schema)) {
+        return Converter::toGVariant(values);
+    }
+
+    const SchemaPlan *plan = schemaPlanCache()->plan(schema);
+    GVariant *result = plan->convertMap(values);
+
+    // not a dictionary schema (or an entry did not fit): convert as usual
+    if (!result) {
+        result = plan->convert(values);
+    }
+    return result;
+}
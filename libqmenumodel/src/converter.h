@@ -23,6 +23,8 @@
 typedef struct _GVariant GVariant;
 class QString;
 class QVariant;
+template <class Key, class T> class QMap;
+typedef QMap<QString, QVariant> QVariantMap;
 
 class Converter
 {
@@ -33,7 +35,12 @@ public:
 
     // This converts a QVariant to a GVariant using a provided gvariant schema as
     // a conversion base (it will attempt to convert to this format).
+    // Schemas are compiled once and the resulting plan is cached.
     static GVariant* toGVariantWithSchema(const QVariant &value, const char* schema);
+
+    // Converts a whole map against a dictionary schema ('a{sv}' or 'a{s*}'),
+    // reusing the compiled plan of the value type for every entry.
+    static GVariant* toGVariantWithSchema(const QVariantMap &values, const char* schema);
 };
 
 #endif // CONVERTER_H
@@ -0,0 +1,164 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+extern "C" {
+#include <glib.h>
+}
+
+#include "gbytesref.h"
+
+#include <string.h>
+
+static void registerGBytesRef()
+{
+    qRegisterMetaType<GBytesRef>("GBytesRef");
+    // QVariant::toByteArray() on a wrapped value hands out a detached copy,
+    // since the caller may keep it longer than the variant.
+    QMetaType::registerConverter<GBytesRef, QByteArray>(&GBytesRef::toByteArray);
+    QMetaType::registerConverter<QByteArray, GBytesRef>(&GBytesRef::fromByteArray);
+    QMetaType::registerEqualsComparator<GBytesRef>();
+}
+Q_CONSTRUCTOR_FUNCTION(registerGBytesRef)
+
+GBytesRef::GBytesRef()
+    : m_bytes(NULL)
+{
+}
+
+/*! \internal
+    Takes a new reference on \a bytes.
+*/
+GBytesRef::GBytesRef(GBytes *bytes)
+    : m_bytes(bytes ? g_bytes_ref(bytes) : NULL)
+{
+    if (m_bytes) {
+        gsize size = 0;
+        gconstpointer data = g_bytes_get_data(m_bytes, &size);
+        m_raw = QByteArray::fromRawData(static_cast<const char*>(data), size);
+    }
+}
+
+GBytesRef::GBytesRef(const GBytesRef &other)
+    : m_bytes(other.m_bytes ? g_bytes_ref(other.m_bytes) : NULL),
+      m_raw(other.m_raw)
+{
+}
+
+GBytesRef::~GBytesRef()
+{
+    // drop the raw view before the buffer it points into
+    m_raw = QByteArray();
+    if (m_bytes) {
+        g_bytes_unref(m_bytes);
+    }
+}
+
+GBytesRef &GBytesRef::operator=(const GBytesRef &other)
+{
+    GBytes *old = m_bytes;
+    m_bytes = other.m_bytes ? g_bytes_ref(other.m_bytes) : NULL;
+    m_raw = other.m_raw;
+    if (old) {
+        g_bytes_unref(old);
+    }
+    return *this;
+}
+
+bool GBytesRef::operator==(const GBytesRef &other) const
+{
+    return m_raw == other.m_raw;
+}
+
+/*! \internal
+    Wraps the serialised data of an 'ay' \a value. A C string keeps its
+    trailing nul in the buffer (so the value converts back unchanged) but
+    not in data(); binary data, with a nul anywhere else, is left as is.
+*/
+GBytesRef GBytesRef::fromVariant(GVariant *value)
+{
+    if (value == NULL || !g_variant_is_of_type(value, G_VARIANT_TYPE_BYTESTRING)) {
+        return GBytesRef();
+    }
+
+    GBytes *bytes = g_variant_get_data_as_bytes(value);
+    GBytesRef ref(bytes);
+    g_bytes_unref(bytes);
+
+    const int length = ref.m_raw.size() - 1;
+    if (length >= 0 && ref.m_raw.at(length) == '\0' &&
+        memchr(ref.m_raw.constData(), '\0', length) == NULL) {
+        ref.m_raw = QByteArray::fromRawData(ref.m_raw.constData(), ref.m_raw.size() - 1);
+    }
+    return ref;
+}
+
+/*! \internal
+    Copies \a data into a new GBytes, for values coming from QML. Data
+    without any nul is taken as a C string and gets a terminator, like
+    Converter::toGVariant() gives it.
+*/
+GBytesRef GBytesRef::fromByteArray(const QByteArray &data)
+{
+    // QByteArray keeps a nul past the end, so the copy can include it
+    const bool terminate = !data.contains('\0');
+    GBytes *bytes = g_bytes_new(data.constData(), data.size() + (terminate ? 1 : 0));
+    GBytesRef ref(bytes);
+    g_bytes_unref(bytes);
+
+    if (terminate) {
+        ref.m_raw = QByteArray::fromRawData(ref.m_raw.constData(), data.size());
+    }
+    return ref;
+}
+
+bool GBytesRef::isNull() const
+{
+    return m_bytes == NULL;
+}
+
+int GBytesRef::size() const
+{
+    return m_raw.size();
+}
+
+const char *GBytesRef::constData() const
+{
+    return m_raw.constData();
+}
+
+QByteArray GBytesRef::data() const
+{
+    return m_raw;
+}
+
+QByteArray GBytesRef::toByteArray() const
+{
+    return QByteArray(m_raw.constData(), m_raw.size());
+}
+
+GBytes *GBytesRef::bytes() const
+{
+    return m_bytes;
+}
+
+/*! \internal
+    Returns a floating 'ay' GVariant backed by the same buffer.
+*/
+GVariant *GBytesRef::toGVariant() const
+{
+    if (m_bytes == NULL) {
+        return g_variant_new_bytestring("");
+    }
+    return g_variant_new_from_bytes(G_VARIANT_TYPE_BYTESTRING, m_bytes, TRUE);
+}
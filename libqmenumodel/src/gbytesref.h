@@ -0,0 +1,64 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GBYTESREF_H
+#define GBYTESREF_H
+
+#include <QByteArray>
+#include <QMetaType>
+
+typedef struct _GBytes GBytes;
+typedef struct _GVariant GVariant;
+
+/*
+ * Shares a GBytes buffer with Qt without copying it.
+ *
+ * The wrapper holds a reference on the GBytes for as long as any copy of
+ * it is alive, and data() exposes the buffer through
+ * QByteArray::fromRawData(). The QByteArray returned by data() must not
+ * outlive the GBytesRef it came from; use toByteArray() to detach.
+ */
+class GBytesRef
+{
+public:
+    GBytesRef();
+    explicit GBytesRef(GBytes *bytes);
+    GBytesRef(const GBytesRef &other);
+    ~GBytesRef();
+
+    GBytesRef &operator=(const GBytesRef &other);
+
+    bool operator==(const GBytesRef &other) const;
+
+    static GBytesRef fromVariant(GVariant *value);
+    static GBytesRef fromByteArray(const QByteArray &data);
+
+    bool isNull() const;
+    int size() const;
+    const char *constData() const;
+
+    QByteArray data() const;
+    QByteArray toByteArray() const;
+
+    GBytes *bytes() const;
+    GVariant *toGVariant() const;
+
+private:
+    GBytes *m_bytes;
+    QByteArray m_raw;
+};
+
+Q_DECLARE_METATYPE(GBytesRef)
+
+#endif // GBYTESREF_H
@@ -65,6 +65,8 @@ struct _GtkActionMuxer
 
   GHashTable *observed_actions;
   GHashTable *groups;
+  GHashTable *resolved;
+  guint       resolved_serial;
   GtkActionMuxer *parent;
 };
 
@@ -88,20 +90,58 @@ typedef struct
   gchar        *fullname;
 } Action;
 
+/* A prefix seen as (pointer, length), so that the prefix of a full
+ * action name can be looked up in place, without copying it out. */
+typedef struct
+{
+  const gchar *str;
+  gsize        len;
+} PrefixKey;
+
 typedef struct
 {
   GtkActionMuxer *muxer;
   GActionGroup *group;
   gchar        *prefix;
+  PrefixKey     key;
   gulong        handler_ids[4];
 } Group;
 
+/* Bumped whenever a group is inserted into or removed from any muxer, or
+ * a muxer changes parent.  Each muxer drops its resolved names when it
+ * sees a new value, so a cached Group can never outlive its muxer entry,
+ * whichever muxer of the parent chain it came from. */
+static guint gtk_action_muxer_resolved_serial = 1;
+
+static guint
+prefix_key_hash (gconstpointer key)
+{
+  const PrefixKey *k = key;
+  guint32 h = 5381;
+  gsize i;
+
+  /* same as g_str_hash(), over len bytes */
+  for (i = 0; i < k->len; i++)
+    h = (h << 5) + h + (signed char) k->str[i];
+
+  return h;
+}
+
+static gboolean
+prefix_key_equal (gconstpointer a,
+                  gconstpointer b)
+{
+  const PrefixKey *ka = a;
+  const PrefixKey *kb = b;
+
+  return ka->len == kb->len && memcmp (ka->str, kb->str, ka->len) == 0;
+}
+
 static void
 gtk_action_muxer_append_group_actions (gpointer key,
                                        gpointer value,
                                        gpointer user_data)
 {
-  const gchar *prefix = key;
   Group *group = value;
   GArray *actions = user_data;
   gchar **group_actions;
@@ -112,7 +152,7 @@ gtk_action_muxer_append_group_actions (gpointer key,
     {
       gchar *fullname;
 
-      fullname = g_strconcat (prefix, ".", *action, NULL);
+      fullname = g_strconcat (group->prefix, ".", *action, NULL);
       g_array_append_val (actions, fullname);
     }
 
@@ -143,7 +183,7 @@ gtk_action_muxer_find_group (GtkActionMuxer  *muxer,
                              const gchar    **action_name)
 {
   const gchar *dot;
-  gchar *prefix;
+  PrefixKey prefix;
   Group *group;
 
   dot = strchr (full_name, '.');
@@ -151,9 +191,9 @@ gtk_action_muxer_find_group (GtkActionMuxer  *muxer,
   if (!dot)
     return NULL;
 
-  prefix = g_strndup (full_name, dot - full_name);
-  group = g_hash_table_lookup (muxer->groups, prefix);
-  g_free (prefix);
+  prefix.str = full_name;
+  prefix.len = dot - full_name;
+  group = g_hash_table_lookup (muxer->groups, &prefix);
 
   if (action_name)
     *action_name = dot + 1;
@@ -161,6 +201,43 @@ gtk_action_muxer_find_group (GtkActionMuxer  *muxer,
   return group;
 }
 
+/* Finds the group providing @full_name in @muxer or the closest of its
+ * ancestors, as the GActionGroup vfuncs would by chaining up.  Answers,
+ * including "none", are remembered per full name until the next change
+ * of serial. */
+static Group *
+gtk_action_muxer_resolve (GtkActionMuxer  *muxer,
+                          const gchar     *full_name,
+                          const gchar    **action_name)
+{
+  GtkActionMuxer *it;
+  gpointer cached;
+  Group *group = NULL;
+
+  if (muxer->resolved_serial != gtk_action_muxer_resolved_serial)
+    {
+      g_hash_table_remove_all (muxer->resolved);
+      muxer->resolved_serial = gtk_action_muxer_resolved_serial;
+    }
+
+  if (g_hash_table_lookup_extended (muxer->resolved, full_name, NULL, &cached))
+    {
+      group = cached;
+    }
+  else
+    {
+      for (it = muxer; it != NULL && group == NULL; it = it->parent)
+        group = gtk_action_muxer_find_group (it, full_name, NULL);
+
+      g_hash_table_insert (muxer->resolved, g_strdup (full_name), group);
+    }
+
+  if (group && action_name)
+    *action_name = full_name + group->key.len + 1;
+
+  return group;
+}
+
 static void
 gtk_action_muxer_action_enabled_changed (GtkActionMuxer *muxer,
                                          const gchar    *action_name,
@@ -346,17 +423,12 @@ gtk_action_muxer_query_action (GActionGroup        *action_group,
   Group *group;
   const gchar *unprefixed_name;
 
-  group = gtk_action_muxer_find_group (muxer, action_name, &unprefixed_name);
+  group = gtk_action_muxer_resolve (muxer, action_name, &unprefixed_name);
 
   if (group)
     return g_action_group_query_action (group->group, unprefixed_name, enabled,
                                         parameter_type, state_type, state_hint, state);
 
-  if (muxer->parent)
-    return g_action_group_query_action (G_ACTION_GROUP (muxer->parent), action_name,
-                                        enabled, parameter_type,
-                                        state_type, state_hint, state);
-
   return FALSE;
 }
 
@@ -369,12 +441,10 @@ gtk_action_muxer_activate_action (GActionGroup *action_group,
   Group *group;
   const gchar *unprefixed_name;
 
-  group = gtk_action_muxer_find_group (muxer, action_name, &unprefixed_name);
+  group = gtk_action_muxer_resolve (muxer, action_name, &unprefixed_name);
 
   if (group)
     g_action_group_activate_action (group->group, unprefixed_name, parameter);
-  else if (muxer->parent)
-    g_action_group_activate_action (G_ACTION_GROUP (muxer->parent), action_name, parameter);
 }
 
 static void
@@ -386,12 +456,10 @@ gtk_action_muxer_change_action_state (GActionGroup *action_group,
   Group *group;
   const gchar *unprefixed_name;
 
-  group = gtk_action_muxer_find_group (muxer, action_name, &unprefixed_name);
+  group = gtk_action_muxer_resolve (muxer, action_name, &unprefixed_name);
 
   if (group)
     g_action_group_change_action_state (group->group, unprefixed_name, state);
-  else if (muxer->parent)
-    g_action_group_change_action_state (G_ACTION_GROUP (muxer->parent), action_name, state);
 }
 
 static void
@@ -498,6 +566,7 @@ gtk_action_muxer_finalize (GObject *object)
   g_assert_cmpint (g_hash_table_size (muxer->observed_actions), ==, 0);
   g_hash_table_unref (muxer->observed_actions);
   g_hash_table_unref (muxer->groups);
+  g_hash_table_unref (muxer->resolved);
 
   G_OBJECT_CLASS (gtk_action_muxer_parent_class)
     ->finalize (object);
@@ -516,6 +585,7 @@ gtk_action_muxer_dispose (GObject *object)
     g_signal_handlers_disconnect_by_func (muxer->parent, gtk_action_muxer_parent_action_state_changed, muxer);
 
     g_clear_object (&muxer->parent);
+    gtk_action_muxer_resolved_serial++;
   }
 
   g_hash_table_remove_all (muxer->observed_actions);
@@ -566,7 +636,9 @@ static void
 gtk_action_muxer_init (GtkActionMuxer *muxer)
 {
   muxer->observed_actions = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, gtk_action_muxer_free_action);
-  muxer->groups = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, gtk_action_muxer_free_group);
+  muxer->groups = g_hash_table_new_full (prefix_key_hash, prefix_key_equal, NULL, gtk_action_muxer_free_group);
+  muxer->resolved = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  muxer->resolved_serial = gtk_action_muxer_resolved_serial;
 }
 
 static void
@@ -638,8 +710,11 @@ gtk_action_muxer_insert (GtkActionMuxer *muxer,
   group->muxer = muxer;
   group->group = g_object_ref (action_group);
   group->prefix = g_strdup (prefix);
+  group->key.str = group->prefix;
+  group->key.len = strlen (group->prefix);
 
-  g_hash_table_insert (muxer->groups, group->prefix, group);
+  g_hash_table_insert (muxer->groups, &group->key, group);
+  gtk_action_muxer_resolved_serial++;
 
   actions = g_action_group_list_actions (group->group);
   for (i = 0; actions[i]; i++)
@@ -670,16 +745,20 @@ void
 gtk_action_muxer_remove (GtkActionMuxer *muxer,
                          const gchar    *prefix)
 {
+  PrefixKey key;
   Group *group;
 
-  group = g_hash_table_lookup (muxer->groups, prefix);
+  key.str = prefix;
+  key.len = strlen (prefix);
+  group = g_hash_table_lookup (muxer->groups, &key);
 
   if (group != NULL)
     {
       gchar **actions;
       gint i;
 
-      g_hash_table_steal (muxer->groups, prefix);
+      g_hash_table_steal (muxer->groups, &key);
+      gtk_action_muxer_resolved_serial++;
 
       actions = g_action_group_list_actions (group->group);
       for (i = 0; actions[i]; i++)
@@ -751,6 +830,7 @@ gtk_action_muxer_set_parent (GtkActionMuxer *muxer,
     }
 
   muxer->parent = parent;
+  gtk_action_muxer_resolved_serial++;
 
   if (muxer->parent != NULL)
     {
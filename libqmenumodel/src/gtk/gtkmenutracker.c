@@ -67,14 +67,23 @@ struct _GtkMenuTracker
   gpointer                  user_data;
 
   GtkMenuTrackerSection    *toplevel;
+
+  /* items created by gtk_menu_tracker_add_items(), in call order, until
+   * they are handed over in one insert_func call */
+  GPtrArray                *pending;
 };
 
 struct _GtkMenuTrackerSection
 {
+  GtkMenuTracker        *tracker;
+  GtkMenuTrackerSection *parent;
   GMenuModel *model;
   GSList     *items;
   gchar      *action_namespace;
 
+  /* flattened size, including our separator and our subsections */
+  gint        n_items;
+
   guint       with_separators : 1;
   guint       has_separator   : 1;
 
@@ -82,43 +91,81 @@ struct _GtkMenuTrackerSection
 };
 
 static GtkMenuTrackerSection *  gtk_menu_tracker_section_new    (GtkMenuTracker        *tracker,
+                                                                 GtkMenuTrackerSection *parent,
                                                                  GMenuModel            *model,
                                                                  gboolean               with_separators,
                                                                  gint                   offset,
                                                                  const gchar           *action_namespace);
 static void                    gtk_menu_tracker_section_free    (GtkMenuTrackerSection *section);
 
-static GtkMenuTrackerSection *
-gtk_menu_tracker_section_find_model (GtkMenuTrackerSection *section,
-                                     GMenuModel            *model,
-                                     gint                  *offset)
+static gint
+gtk_menu_tracker_section_measure (GtkMenuTrackerSection *section)
 {
-  GSList *item;
+  if (section == NULL)
+    return 1;
 
-  if (section->has_separator)
-    (*offset)++;
+  return section->n_items;
+}
 
-  if (section->model == model)
-    return section;
+/* hands everything queued by gtk_menu_tracker_add_items() to the
+ * insert callback at once.  Items were all created for the same
+ * position, each one going in front of the previous ones, so the batch
+ * is in reverse order of creation.
+ */
+static void
+gtk_menu_tracker_flush_items (GtkMenuTracker *tracker,
+                              gint            offset)
+{
+  GPtrArray *pending = tracker->pending;
+  guint i;
 
-  for (item = section->items; item; item = item->next)
+  if (pending->len == 0)
+    return;
+
+  for (i = 0; i < pending->len / 2; i++)
     {
-      GtkMenuTrackerSection *subsection = item->data;
+      gpointer tmp = pending->pdata[i];
 
-      if (subsection)
-        {
-          GtkMenuTrackerSection *found_section;
+      pending->pdata[i] = pending->pdata[pending->len - 1 - i];
+      pending->pdata[pending->len - 1 - i] = tmp;
+    }
 
-          found_section = gtk_menu_tracker_section_find_model (subsection, model, offset);
+  (* tracker->insert_func) ((GtkMenuTrackerItem **) pending->pdata, offset, pending->len, tracker->user_data);
+  g_ptr_array_set_size (pending, 0);
+}
 
-          if (found_section)
-            return found_section;
+/* adds @delta to the size of @section and of all the sections holding it */
+static void
+gtk_menu_tracker_section_resize (GtkMenuTrackerSection *section,
+                                 gint                   delta)
+{
+  for (; section; section = section->parent)
+    section->n_items += delta;
+}
+
+/* returns the position of the first item of @section (after its
+ * separator) within the overall menu, by summing the sizes of what
+ * comes before it at each level up to the toplevel.
+ */
+static gint
+gtk_menu_tracker_section_get_offset (GtkMenuTrackerSection *section)
+{
+  gint offset = 0;
+
+  for (; section; section = section->parent)
+    {
+      offset += section->has_separator;
+
+      if (section->parent)
+        {
+          GSList *item;
+
+          for (item = section->parent->items; item->data != section; item = item->next)
+            offset += gtk_menu_tracker_section_measure (item->data);
         }
-      else
-        (*offset)++;
     }
 
-  return FALSE;
+  return offset;
 }
 
 /* this is responsible for syncing the showing of a separator for a
@@ -197,16 +244,18 @@ gtk_menu_tracker_section_sync_separators (GtkMenuTrackerSection *section,
       GtkMenuTrackerItem *item;
 
       item = _gtk_menu_tracker_item_new (tracker->observable, parent_model, parent_index, NULL, TRUE);
-      (* tracker->insert_func) (item, offset, tracker->user_data);
+      (* tracker->insert_func) (&item, offset, 1, tracker->user_data);
       g_object_unref (item);
 
       section->has_separator = TRUE;
+      gtk_menu_tracker_section_resize (section, 1);
     }
   else if (should_have_separator < section->has_separator)
     {
       /* Remove a separator */
-      (* tracker->remove_func) (offset, tracker->user_data);
+      (* tracker->remove_func) (offset, 1, tracker->user_data);
       section->has_separator = FALSE;
+      gtk_menu_tracker_section_resize (section, -1);
     }
 
   n_items += section->has_separator;
@@ -214,32 +263,14 @@ gtk_menu_tracker_section_sync_separators (GtkMenuTrackerSection *section,
   return n_items;
 }
 
-static gint
-gtk_menu_tracker_section_measure (GtkMenuTrackerSection *section)
-{
-  GSList *item;
-  gint n_items;
-
-  if (section == NULL)
-    return 1;
-
-  n_items = 0;
-
-  if (section->has_separator)
-    n_items++;
-
-  for (item = section->items; item; item = item->next)
-    n_items += gtk_menu_tracker_section_measure (item->data);
-
-  return n_items;
-}
-
 static void
-gtk_menu_tracker_remove_items (GtkMenuTracker  *tracker,
-                               GSList         **change_point,
-                               gint             offset,
-                               gint             n_items)
+gtk_menu_tracker_remove_items (GtkMenuTracker         *tracker,
+                               GtkMenuTrackerSection  *section,
+                               GSList                **change_point,
+                               gint                    offset,
+                               gint                    n_items)
 {
+  gint removed = 0;
   gint i;
 
   for (i = 0; i < n_items; i++)
@@ -252,10 +283,14 @@ gtk_menu_tracker_remove_items (GtkMenuTracker  *tracker,
 
       n = gtk_menu_tracker_section_measure (subsection);
       gtk_menu_tracker_section_free (subsection);
+      gtk_menu_tracker_section_resize (section, -n);
 
-      while (n--)
-        (* tracker->remove_func) (offset, tracker->user_data);
+      removed += n;
     }
+
+  /* the removed items are adjacent, drop them as one range */
+  if (removed > 0)
+    (* tracker->remove_func) (offset, removed, tracker->user_data);
 }
 
 static void
@@ -286,11 +321,11 @@ gtk_menu_tracker_add_items (GtkMenuTracker         *tracker,
               gchar *namespace;
 
               namespace = g_strjoin (".", section->action_namespace, action_namespace, NULL);
-              subsection = gtk_menu_tracker_section_new (tracker, submenu, FALSE, offset, namespace);
+              subsection = gtk_menu_tracker_section_new (tracker, section, submenu, FALSE, offset, namespace);
               g_free (namespace);
             }
           else
-            subsection = gtk_menu_tracker_section_new (tracker, submenu, FALSE, offset, section->action_namespace);
+            subsection = gtk_menu_tracker_section_new (tracker, section, submenu, FALSE, offset, section->action_namespace);
 
           *change_point = g_slist_prepend (*change_point, subsection);
           g_free (action_namespace);
@@ -302,10 +337,10 @@ gtk_menu_tracker_add_items (GtkMenuTracker         *tracker,
 
           item = _gtk_menu_tracker_item_new (tracker->observable, model, position + n_items,
                                              section->action_namespace, FALSE);
-          (* tracker->insert_func) (item, offset, tracker->user_data);
-          g_object_unref (item);
+          g_ptr_array_add (tracker->pending, item);
 
           *change_point = g_slist_prepend (*change_point, NULL);
+          gtk_menu_tracker_section_resize (section, 1);
         }
     }
 }
@@ -317,16 +352,18 @@ gtk_menu_tracker_model_changed (GMenuModel *model,
                                 gint        added,
                                 gpointer    user_data)
 {
-  GtkMenuTracker *tracker = user_data;
-  GtkMenuTrackerSection *section;
+  GtkMenuTrackerSection *section = user_data;
+  GtkMenuTracker *tracker = section->tracker;
   GSList **change_point;
-  gint offset = 0;
+  gint offset;
   gint i;
 
-  /* First find which section the changed model corresponds to, and the
-   * position of that section within the overall menu.
+  /* First find the position of the changed section within the overall
+   * menu.  Each section is handed its own change notifications, and
+   * knows its parent and size, so this only looks at the sections on
+   * the way up to the toplevel.
    */
-  section = gtk_menu_tracker_section_find_model (tracker->toplevel, model, &offset);
+  offset = gtk_menu_tracker_section_get_offset (section);
 
   /* Next, seek through that section to the change point.  This gives us
    * the correct GSList** to make the change to and also finds the final
@@ -351,8 +388,9 @@ gtk_menu_tracker_model_changed (GMenuModel *model,
    * means that we can populate in O(n) time instead of O(n^2) that we
    * would do by appending.
    */
-  gtk_menu_tracker_remove_items (tracker, change_point, offset, removed);
+  gtk_menu_tracker_remove_items (tracker, section, change_point, offset, removed);
   gtk_menu_tracker_add_items (tracker, section, change_point, offset, model, position, added);
+  gtk_menu_tracker_flush_items (tracker, offset);
 
   /* The offsets for insertion/removal of separators will be all over
    * the place, however...
@@ -374,21 +412,27 @@ gtk_menu_tracker_section_free (GtkMenuTrackerSection *section)
 }
 
 static GtkMenuTrackerSection *
-gtk_menu_tracker_section_new (GtkMenuTracker *tracker,
-                              GMenuModel     *model,
-                              gboolean        with_separators,
-                              gint            offset,
-                              const gchar    *action_namespace)
+gtk_menu_tracker_section_new (GtkMenuTracker        *tracker,
+                              GtkMenuTrackerSection *parent,
+                              GMenuModel            *model,
+                              gboolean               with_separators,
+                              gint                   offset,
+                              const gchar           *action_namespace)
 {
   GtkMenuTrackerSection *section;
 
+  /* linked to @parent from the start, so that the items we add here
+   * are accounted for in its size as well
+   */
   section = g_slice_new0 (GtkMenuTrackerSection);
+  section->tracker = tracker;
+  section->parent = parent;
   section->model = g_object_ref (model);
   section->with_separators = with_separators;
   section->action_namespace = g_strdup (action_namespace);
 
   gtk_menu_tracker_add_items (tracker, section, &section->items, offset, model, 0, g_menu_model_get_n_items (model));
-  section->handler = g_signal_connect (model, "items-changed", G_CALLBACK (gtk_menu_tracker_model_changed), tracker);
+  section->handler = g_signal_connect (model, "items-changed", G_CALLBACK (gtk_menu_tracker_model_changed), section);
 
   return section;
 }
@@ -411,9 +455,9 @@ gtk_menu_tracker_section_new (GtkMenuTracker *tracker,
  * updates on the fly.  It also handles action_namespace for subsections
  * (but you will need to handle it yourself for submenus).
  *
- * When the tracker is first created, @insert_func will be called many
- * times to populate the menu with the initial contents of @model
- * (unless it is empty), before gtk_menu_tracker_new() returns.  For
+ * When the tracker is first created, @insert_func will be called to
+ * populate the menu with the initial contents of @model (unless it is
+ * empty), before gtk_menu_tracker_new() returns.  For
  * this reason, the menu that is using the tracker ought to be empty
  * when it creates the tracker.
  *
@@ -421,8 +465,13 @@ gtk_menu_tracker_section_new (GtkMenuTracker *tracker,
  * and @remove_func.
  *
  * The position argument to both functions is the linear 0-based
- * position in the menu at which the item in question should be inserted
- * or removed.
+ * position in the menu at which the items in question should be inserted
+ * or removed.  Both work on ranges: @insert_func gets an array of
+ * n_items items to insert in order starting at position (they are only
+ * borrowed for the duration of the call), and @remove_func gets the
+ * number of adjacent items to remove starting at position.  All the
+ * items added or removed by one change of a model, subsections
+ * included, are reported in a single call.
  *
  * For @insert_func, @model and @item_index are used to get the
  * information about the menu item to insert.  @action_namespace is the
@@ -460,8 +509,10 @@ gtk_menu_tracker_new (GtkActionObservable      *observable,
   tracker->insert_func = insert_func;
   tracker->remove_func = remove_func;
   tracker->user_data = user_data;
+  tracker->pending = g_ptr_array_new_with_free_func (g_object_unref);
 
-  tracker->toplevel = gtk_menu_tracker_section_new (tracker, model, with_separators, 0, action_namespace);
+  tracker->toplevel = gtk_menu_tracker_section_new (tracker, NULL, model, with_separators, 0, action_namespace);
+  gtk_menu_tracker_flush_items (tracker, 0);
   gtk_menu_tracker_section_sync_separators (tracker->toplevel, tracker, 0, FALSE, NULL, 0);
 
   return tracker;
@@ -490,6 +541,7 @@ void
 gtk_menu_tracker_free (GtkMenuTracker *tracker)
 {
   gtk_menu_tracker_section_free (tracker->toplevel);
+  g_ptr_array_unref (tracker->pending);
   g_object_unref (tracker->observable);
   g_slice_free (GtkMenuTracker, tracker);
 }
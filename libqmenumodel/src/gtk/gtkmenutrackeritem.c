@@ -91,9 +91,15 @@ struct _GtkMenuTrackerItem
   guint toggled : 1;
   guint submenu_shown : 1;
   guint submenu_requested : 1;
+  guint hidden_when : 2;
+  guint is_visible : 1;
   GVariant *action_state;
 };
 
+#define HIDDEN_NEVER         0
+#define HIDDEN_WHEN_MISSING  1
+#define HIDDEN_WHEN_DISABLED 2
+
 enum {
   PROP_0,
   PROP_IS_SEPARATOR,
@@ -250,6 +256,33 @@ gtk_menu_tracker_item_class_init (GtkMenuTrackerItemClass *class)
   g_object_class_install_properties (class, N_PROPS, gtk_menu_tracker_item_pspecs);
 }
 
+static void
+gtk_menu_tracker_item_update_visibility (GtkMenuTrackerItem *self)
+{
+  gboolean visible;
+
+  switch (self->hidden_when)
+    {
+    case HIDDEN_WHEN_MISSING:
+      visible = self->can_activate;
+      break;
+
+    case HIDDEN_WHEN_DISABLED:
+      visible = self->sensitive;
+      break;
+
+    default:
+      visible = TRUE;
+      break;
+    }
+
+  if (visible != self->is_visible)
+    {
+      self->is_visible = visible;
+      g_object_notify_by_pspec (G_OBJECT (self), gtk_menu_tracker_item_pspecs[PROP_VISIBLE]);
+    }
+}
+
 static void
 gtk_menu_tracker_item_action_added (GtkActionObserver   *observer,
                                     GtkActionObservable *observable,
@@ -271,6 +304,7 @@ gtk_menu_tracker_item_action_added (GtkActionObserver   *observer,
     {
       if (action_target)
         g_variant_unref (action_target);
+      gtk_menu_tracker_item_update_visibility (self);
       return;
     }
 
@@ -309,6 +343,8 @@ gtk_menu_tracker_item_action_added (GtkActionObserver   *observer,
 
   if (action_target)
     g_variant_unref (action_target);
+
+  gtk_menu_tracker_item_update_visibility (self);
 }
 
 static void
@@ -328,6 +364,8 @@ gtk_menu_tracker_item_action_enabled_changed (GtkActionObserver   *observer,
   self->sensitive = enabled;
 
   g_object_notify_by_pspec (G_OBJECT (self), gtk_menu_tracker_item_pspecs[PROP_SENSITIVE]);
+
+  gtk_menu_tracker_item_update_visibility (self);
 }
 
 static void
@@ -377,6 +415,8 @@ gtk_menu_tracker_item_action_removed (GtkActionObserver   *observer,
   if (!self->can_activate)
     return;
 
+  self->can_activate = FALSE;
+
   g_object_freeze_notify (G_OBJECT (self));
 
   if (self->sensitive)
@@ -405,6 +445,8 @@ gtk_menu_tracker_item_action_removed (GtkActionObserver   *observer,
     }
 
   g_object_thaw_notify (G_OBJECT (self));
+
+  gtk_menu_tracker_item_update_visibility (self);
 }
 
 static void
@@ -438,6 +480,7 @@ _gtk_menu_tracker_item_new (GtkActionObservable *observable,
   if (!is_separator && g_menu_item_get_attribute (self->item, "action", "&s", &action_name))
     {
       GActionGroup *group = G_ACTION_GROUP (observable);
+      const gchar *hidden_when;
       const GVariantType *parameter_type;
       gboolean enabled;
       GVariant *state;
@@ -445,6 +488,14 @@ _gtk_menu_tracker_item_new (GtkActionObservable *observable,
 
       state = NULL;
 
+      if (g_menu_item_get_attribute (self->item, "hidden-when", "&s", &hidden_when))
+        {
+          if (g_str_equal (hidden_when, "action-missing"))
+            self->hidden_when = HIDDEN_WHEN_MISSING;
+          else if (g_str_equal (hidden_when, "action-disabled"))
+            self->hidden_when = HIDDEN_WHEN_DISABLED;
+        }
+
       if (action_namespace)
         {
           gchar *full_action;
@@ -465,11 +516,16 @@ _gtk_menu_tracker_item_new (GtkActionObservable *observable,
       else
         gtk_menu_tracker_item_action_removed (GTK_ACTION_OBSERVER (self), observable, NULL);
 
+      gtk_menu_tracker_item_update_visibility (self);
+
       if (state)
         g_variant_unref (state);
     }
   else
-    self->sensitive = TRUE;
+    {
+      self->sensitive = TRUE;
+      self->is_visible = TRUE;
+    }
 
   return self;
 }
@@ -559,7 +615,7 @@ gtk_menu_tracker_item_get_sensitive (GtkMenuTrackerItem *self)
 gboolean
 gtk_menu_tracker_item_get_visible (GtkMenuTrackerItem *self)
 {
-  return TRUE;
+  return self->is_visible;
 }
 
 GtkMenuTrackerItemRole
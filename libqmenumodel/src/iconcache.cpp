@@ -0,0 +1,218 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+extern "C" {
+#include <gio/gio.h>
+}
+
+#include "iconcache.h"
+#include "gbytesref.h"
+
+#include <QCache>
+#include <QIcon>
+#include <QMutex>
+#include <QQmlEngine>
+
+static const char *providerId = "unitymenuicon";
+
+/*! \internal
+    Cache key holding a reference on a GIcon, compared by icon content.
+*/
+class IconKey
+{
+public:
+    explicit IconKey(GIcon *icon)
+        : m_icon(G_ICON(g_object_ref(icon)))
+    {
+    }
+
+    IconKey(const IconKey &other)
+        : m_icon(G_ICON(g_object_ref(other.m_icon)))
+    {
+    }
+
+    ~IconKey()
+    {
+        g_object_unref(m_icon);
+    }
+
+    IconKey &operator=(const IconKey &other)
+    {
+        GIcon *old = m_icon;
+        m_icon = G_ICON(g_object_ref(other.m_icon));
+        g_object_unref(old);
+        return *this;
+    }
+
+    bool operator==(const IconKey &other) const
+    {
+        return g_icon_equal(m_icon, other.m_icon);
+    }
+
+    GIcon *m_icon;
+};
+
+static uint qHash(const IconKey &key)
+{
+    return g_icon_hash(key.m_icon);
+}
+
+/*! \internal
+    Resolved URIs and the image data behind image://unitymenuicon/ URIs.
+    The provider may be called from the QML loader thread, hence the lock.
+*/
+class IconStore
+{
+public:
+    IconStore()
+        : uris(512),
+          images(16 * 1024),
+          nextId(0)
+    {
+    }
+
+    QMutex lock;
+    QString themeName;
+    QCache<IconKey, QString> uris;
+    // cost is the size in KiB
+    QCache<QString, GBytesRef> images;
+    quint64 nextId;
+};
+
+Q_GLOBAL_STATIC(IconStore, iconStore)
+
+static QString imageUriPrefix()
+{
+    return QString("image://%1/").arg(providerId);
+}
+
+static QString resolveUri(IconStore *store, GIcon *icon)
+{
+    QString uri;
+
+    if (G_IS_THEMED_ICON (icon)) {
+        const gchar* const* iconNames = g_themed_icon_get_names (G_THEMED_ICON (icon));
+        guint index = 0;
+        while(iconNames[index] != NULL) {
+            if (QIcon::hasThemeIcon(iconNames[index])) {
+                uri = QString("image://theme/") + iconNames[index];
+                break;
+            }
+            index++;
+        }
+    }
+    else if (G_IS_FILE_ICON (icon)) {
+        GFile *file;
+
+        file = g_file_icon_get_file (G_FILE_ICON (icon));
+        if (file) {
+            gchar *fileuri;
+
+            fileuri = g_file_get_uri (file);
+            uri = QString(fileuri);
+
+            g_free (fileuri);
+        }
+    }
+    else if (G_IS_BYTES_ICON (icon)) {
+        GBytesRef *bytes = new GBytesRef(g_bytes_icon_get_bytes (G_BYTES_ICON (icon)));
+        const int cost = qMax(1, bytes->size() / 1024);
+
+        if (cost <= store->images.maxCost()) {
+            QString id = QString::number(++store->nextId);
+            store->images.insert(id, bytes, cost);
+            uri = imageUriPrefix() + id;
+        } else {
+            // QCache would drop it right away, inline it as before
+            gchar *base64 = g_base64_encode ((const guchar *) bytes->constData(), bytes->size());
+            uri = QString("data://") + base64;
+            g_free (base64);
+            delete bytes;
+        }
+    }
+
+    return uri;
+}
+
+/*! \internal
+    Returns the image source URI for \a icon, or an empty string if it
+    cannot be shown.
+*/
+QString IconCache::uri(GIcon *icon)
+{
+    IconStore *store = iconStore();
+    QMutexLocker locker(&store->lock);
+
+    const QString themeName = QIcon::themeName();
+    if (themeName != store->themeName) {
+        store->uris.clear();
+        store->themeName = themeName;
+    }
+
+    IconKey key(icon);
+    QString *cached = store->uris.object(key);
+    if (cached) {
+        // the two caches evict independently; a provider URI is only good
+        // while its image is still stored
+        const QString prefix = imageUriPrefix();
+        if (!cached->startsWith(prefix) || store->images.contains(cached->mid(prefix.size()))) {
+            return *cached;
+        }
+    }
+
+    QString uri = resolveUri(store, icon);
+    store->uris.insert(key, new QString(uri));
+    return uri;
+}
+
+/*! \internal
+    Adds the provider for bytes icons to \a engine unless it has one.
+*/
+void IconCache::registerImageProvider(QQmlEngine *engine)
+{
+    if (engine && !engine->imageProvider(providerId)) {
+        engine->addImageProvider(providerId, new IconImageProvider);
+    }
+}
+
+IconImageProvider::IconImageProvider()
+    : QQuickImageProvider(QQuickImageProvider::Image)
+{
+}
+
+QImage IconImageProvider::requestImage(const QString &id, QSize *size, const QSize &requestedSize)
+{
+    GBytesRef bytes;
+    {
+        IconStore *store = iconStore();
+        QMutexLocker locker(&store->lock);
+        GBytesRef *stored = store->images.object(id);
+        if (stored) {
+            bytes = *stored;
+        }
+    }
+
+    QImage image;
+    if (!bytes.isNull()) {
+        image.loadFromData(reinterpret_cast<const uchar *>(bytes.constData()), bytes.size());
+    }
+
+    if (size) {
+        *size = image.size();
+    }
+    if (!image.isNull() && (requestedSize.width() > 0) && (requestedSize.height() > 0)) {
+        image = image.scaled(requestedSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    }
+    return image;
+}
@@ -0,0 +1,42 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ICONCACHE_H
+#define ICONCACHE_H
+
+#include <QQuickImageProvider>
+
+class QQmlEngine;
+typedef struct _GIcon GIcon;
+
+// Resolves GIcons to image source URIs. Results are cached per icon (by
+// g_icon_hash/g_icon_equal) until the icon theme changes. Bytes icons are
+// served by IconImageProvider under image://unitymenuicon/ instead of
+// being inlined as data URIs.
+class IconCache
+{
+public:
+    static QString uri(GIcon *icon);
+    static void registerImageProvider(QQmlEngine *engine);
+};
+
+class IconImageProvider : public QQuickImageProvider
+{
+public:
+    IconImageProvider();
+
+    QImage requestImage(const QString &id, QSize *size, const QSize &requestedSize);
+};
+
+#endif // ICONCACHE_H
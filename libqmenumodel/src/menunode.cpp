@@ -24,27 +24,35 @@
 #include <QDebug>
 #include <QCoreApplication>
 
-MenuNode::MenuNode(const QString &linkType, GMenuModel *model, MenuNode *parent, int pos, QObject *listener)
+MenuNode::MenuNode(const QString &linkType, GMenuModel *model, MenuNode *parent, int pos, QObject *listener,
+                   MenuNodeIndex *index)
     : m_model(model),
       m_parent(parent),
+      m_position(0),
+      m_depth(0),
+      m_size(0),
+      m_listener(listener),
+      m_index(parent ? parent->m_index : index),
       m_signalChangedId(0),
       m_linkType(linkType),
       m_currentOpPosition(-1),
       m_currentOpAdded(0),
-      m_currentOpRemoved(0)
+      m_currentOpRemoved(0),
+      m_populated(false),
+      m_lastAccess(0)
 {
     g_object_ref(model);
 
-    if (m_parent) {
-        m_parent->insertChild(this, pos);
+    if (m_index) {
+        m_index->insert(model, this);
     }
 
-    m_size = g_menu_model_get_n_items(model);
-    for(int i=0; i < m_size; i++) {
-        MenuNode::create(model, i, this, listener);
+    if (m_parent) {
+        m_parent->insertChild(this, pos);
+    } else {
+        // only the root is filled up front, links wait for populate()
+        populate();
     }
-
-    connect(listener);
 }
 
 MenuNode::~MenuNode()
@@ -54,6 +62,9 @@ MenuNode::~MenuNode()
         delete child;
     }
     m_children.clear();
+    if (m_index && (m_index->value(m_model) == this)) {
+        m_index->remove(m_model);
+    }
     if (m_model) {
         g_object_unref(m_model);
     }
@@ -74,16 +85,77 @@ void MenuNode::disconnect()
 {
     if (m_signalChangedId != 0) {
         g_signal_handler_disconnect(m_model, m_signalChangedId);
+        m_signalChangedId = 0;
     }
 }
 
-int MenuNode::position() const
+bool MenuNode::isPopulated() const
 {
-    if (m_parent) {
-        return m_parent->childPosition(this);
-    } else {
-        return 0;
+    return m_populated;
+}
+
+/*! \internal
+    Reads the items of the linked model and starts tracking its changes.
+    Nothing below a node is queried or subscribed to before this is called,
+    and its own children are created unpopulated in turn.
+*/
+void MenuNode::populate()
+{
+    if (m_populated) {
+        return;
+    }
+    m_populated = true;
+
+    m_size = g_menu_model_get_n_items(m_model);
+    m_children.fill(0, m_size);
+    m_cache.fill(ItemCache(), m_size);
+    for(int i=0; i < m_size; i++) {
+        MenuNode::create(m_model, i, this, m_listener);
+    }
+
+    connect(m_listener);
+}
+
+/*! \internal
+    Drops the children and the items-changed handler, returning the node to
+    the state it had before populate().
+*/
+void MenuNode::release()
+{
+    if (!m_populated) {
+        return;
     }
+
+    disconnect();
+    Q_FOREACH(MenuNode *child, m_children) {
+        delete child;
+    }
+    m_children.clear();
+    m_cache.clear();
+    m_size = 0;
+    m_currentOpPosition = -1;
+    m_currentOpAdded = m_currentOpRemoved = 0;
+    m_populated = false;
+}
+
+qint64 MenuNode::lastAccess() const
+{
+    return m_lastAccess;
+}
+
+/*! \internal
+    Stamps this node and its ancestors as used at \a now.
+*/
+void MenuNode::touch(qint64 now)
+{
+    for (MenuNode *node = this; node && (node->m_lastAccess != now); node = node->m_parent) {
+        node->m_lastAccess = now;
+    }
+}
+
+int MenuNode::position() const
+{
+    return m_position;
 }
 
 MenuNode *MenuNode::parent() const
@@ -103,25 +175,34 @@ QString MenuNode::linkType() const
 
 MenuNode *MenuNode::child(int pos) const
 {
-    if (m_children.contains(pos)) {
-        return m_children.value(pos);
+    if ((pos >= 0) && (pos < m_children.size())) {
+        return m_children.at(pos);
     }
     return 0;
 }
 
 int MenuNode::childPosition(GMenuModel *item) const
 {
-    QMap<int, MenuNode*>::const_iterator i = m_children.constBegin();
-    while (i != m_children.constEnd()) {
-        if (i.value()->m_model == item) {
-            return i.key();
+    if (m_index) {
+        MenuNode *node = m_index->value(item);
+        if (node && (node->m_parent == this)) {
+            return node->m_position;
+        }
+    }
+
+    for (int i = 0, iMax = m_children.size(); i < iMax; i++) {
+        const MenuNode *child = m_children.at(i);
+        if (child && (child->m_model == item)) {
+            return i;
         }
-        ++i;
     }
     return 0;
 }
 int MenuNode::childPosition(const MenuNode *item) const
 {
+    if (item->m_parent == this) {
+        return item->m_position;
+    }
     return childPosition(item->m_model);
 }
 
@@ -132,13 +213,7 @@ int MenuNode::size() const
 
 int MenuNode::depth() const
 {
-    int depth = 0;
-    const MenuNode *child = this;
-    while(child->parent()) {
-        depth++;
-        child = child->parent();
-    }
-    return depth;
+    return m_depth;
 }
 
 int MenuNode::realPosition(int row) const
@@ -158,44 +233,111 @@ int MenuNode::realPosition(int row) const
     }
 }
 
+/*! \internal
+    Applies an items-changed to the children: \a removed items are dropped
+    at \a start, then \a added items are inserted there.
+*/
 void MenuNode::change(int start, int added, int removed)
 {
-    if (added > 0) {
-        for (int i=(m_size - 1 + added), iMin=start; i >= iMin; i--) {
-            if (m_children.contains(i)) {
-                m_children.insert(i + added, m_children.take(i));
-            }
-        }
+    removeChildren(start, removed);
+    insertChildren(start, added);
+}
 
-        m_size += added;
+void MenuNode::removeChildren(int start, int count)
+{
+    if (count <= 0) {
+        return;
+    }
 
-        for (int i = start; i < (start + added); i++) {
-            MenuNode::create(m_model, i, this, m_listener);
-        }
+    for (int i = start, iMax = start + count; i < iMax; i++) {
+        delete m_children.at(i);
     }
+    m_children.remove(start, count);
+    m_cache.remove(start, count);
+    m_size -= count;
 
-    if (removed > 0) {
-        int removedEnd = start + removed;
-        for (int i=start, iMax=m_size; i < iMax; i++) {
-            if (i <= removedEnd) {
-                delete m_children.take(i);
-            } else if (m_children.contains(i)) {
-                m_children.insert(i - removed, m_children.take(i));
-            }
-        }
-        m_size -= removed;
+    updatePositions(start);
+}
+
+void MenuNode::insertChildren(int start, int count)
+{
+    if (count <= 0) {
+        return;
+    }
+
+    m_children.insert(start, count, 0);
+    m_cache.insert(start, count, ItemCache());
+    m_size += count;
+
+    updatePositions(start + count);
+
+    for (int i = start; i < (start + count); i++) {
+        MenuNode::create(m_model, i, this, m_listener);
+    }
+}
+
+/*! \internal
+    Looks up the decoded \a attribute of the item in slot \a pos. Returns
+    false if it has not been cached yet.
+*/
+bool MenuNode::cachedAttribute(int pos, CachedAttribute attribute, QVariant *value) const
+{
+    if ((pos < 0) || (pos >= m_cache.size())) {
+        return false;
+    }
+
+    const ItemCache &cache = m_cache.at(pos);
+    if (cache.filled & (1 << attribute)) {
+        *value = cache.values[attribute];
+        return true;
+    }
+    return false;
+}
+
+/*! \internal
+    Remembers \a value for the item in slot \a pos. Items never change in
+    place, so the entry lives until items-changed removes the slot.
+*/
+void MenuNode::cacheAttribute(int pos, CachedAttribute attribute, const QVariant &value)
+{
+    if ((pos < 0) || (pos >= m_cache.size())) {
+        return;
     }
+
+    ItemCache &cache = m_cache[pos];
+    cache.values[attribute] = value;
+    cache.filled |= (1 << attribute);
 }
 
 void MenuNode::insertChild(MenuNode *child, int pos)
 {
-    if (m_children.contains(pos)) {
+    if ((pos < 0) || (pos >= m_children.size())) {
+        qWarning() << "Invalid child position: parent" << this << "child" << child << "pos" << pos;
+        return;
+    }
+    if (m_children.at(pos)) {
         qWarning() << "Section conflic: parent" << this << "child" << child << "pos" << pos;
         return;
     }
 
     child->m_parent = this;
-    m_children.insert(pos, child);
+    child->m_position = pos;
+    child->m_depth = m_depth + 1;
+    m_children[pos] = child;
+}
+
+/*! \internal
+    Refreshes the cached position of every child from \a start on, after
+    the slots have been shifted.
+*/
+void MenuNode::updatePositions(int start)
+{
+    for (int i = start, iMax = m_children.size(); i < iMax; i++) {
+        MenuNode *child = m_children.at(i);
+        if (child) {
+            child->m_position = i;
+        }
+    }
 }
 
 
@@ -205,7 +347,20 @@ MenuNode *MenuNode::find(GMenuModel *item)
         return this;
     }
 
+    if (m_index) {
+        // the indexed node only counts if it lives below this one
+        MenuNode *node = m_index->value(item);
+        for (MenuNode *parent = node ? node->m_parent : 0; parent; parent = parent->m_parent) {
+            if (parent == this) {
+                return node;
+            }
+        }
+    }
+
     Q_FOREACH(MenuNode *child, m_children) {
+        if (!child) {
+            continue;
+        }
         MenuNode *found = child->find(item);
         if (found) {
             return found;
@@ -229,12 +384,32 @@ MenuNode *MenuNode::create(GMenuModel *model, int pos, MenuNode *parent, QObject
     return 0;
 }
 
+/*! \internal
+    Applies the removal half of the pending items-changed. Used between
+    beginRemoveRows() and endRemoveRows().
+*/
+void MenuNode::commitRemoval()
+{
+    removeChildren(m_currentOpPosition, m_currentOpRemoved);
+    m_currentOpRemoved = 0;
+}
+
+/*! \internal
+    Applies the insertion half of the pending items-changed. Used between
+    beginInsertRows() and endInsertRows().
+*/
+void MenuNode::commitInsertion()
+{
+    insertChildren(m_currentOpPosition, m_currentOpAdded);
+    m_currentOpAdded = 0;
+}
+
 void MenuNode::commitOperation()
 {
-    change(m_currentOpPosition, m_currentOpAdded, m_currentOpRemoved);
+    commitRemoval();
+    commitInsertion();
 
     m_currentOpPosition = -1;
-    m_currentOpAdded = m_currentOpRemoved = 0;
 }
 
 void MenuNode::onItemsChanged(GMenuModel *model, gint position, gint removed, gint added, gpointer data)
@@ -244,7 +419,7 @@ void MenuNode::onItemsChanged(GMenuModel *model, gint position, gint removed, gi
     self->m_currentOpAdded = added;
     self->m_currentOpRemoved = removed;
 
-    MenuNodeItemChangeEvent mnice(self, position, added, removed);
+    MenuNodeItemChangeEvent mnice(self, position, removed, added);
     QCoreApplication::sendEvent(self->m_listener, &mnice);
 
     self->commitOperation();
@@ -20,19 +20,32 @@
 #ifndef MENUNODE_H
 #define MENUNODE_H
 
+#include <QHash>
 #include <QObject>
 #include <QPointer>
-#include <QMap>
+#include <QVector>
 #include <QVariant>
 
 extern "C" {
 #include <gio/gio.h>
 }
 
+class MenuNode;
+
+// maps each model in a tree to the node wrapping it
+typedef QHash<GMenuModel*, MenuNode*> MenuNodeIndex;
+
 class MenuNode
 {
 public:
-    MenuNode(const QString &linkType, GMenuModel *model, MenuNode *parent, int pos, QObject *listener);
+    enum CachedAttribute {
+        LabelAttribute,
+        ActionAttribute,
+        ExtraAttribute
+    };
+
+    MenuNode(const QString &linkType, GMenuModel *model, MenuNode *parent, int pos, QObject *listener,
+             MenuNodeIndex *index = 0);
     ~MenuNode();
 
     int position() const;
@@ -42,6 +55,14 @@ public:
 
     void connect(QObject *listener);
     void disconnect();
+
+    bool isPopulated() const;
+    void populate();
+    void release();
+
+    qint64 lastAccess() const;
+    void touch(qint64 now);
+
     int size() const;
     MenuNode *child(int pos) const;
 
@@ -53,22 +74,46 @@ public:
     void change(int start, int added, int removed);
     MenuNode *find(GMenuModel *item);
 
+    bool cachedAttribute(int pos, CachedAttribute attribute, QVariant *value) const;
+    void cacheAttribute(int pos, CachedAttribute attribute, const QVariant &value);
+
     int realPosition(int row) const;
+    void commitRemoval();
+    void commitInsertion();
     void commitOperation();
 
     static MenuNode *create(GMenuModel *model, int pos, MenuNode *parent=0, QObject *listener=0);
 
 private:
+    struct ItemCache {
+        ItemCache() : filled(0) {}
+
+        int filled;
+        QVariant values[ExtraAttribute + 1];
+    };
+
     GMenuModel *m_model;
-    QMap<int, MenuNode*> m_children;
+    // one slot per item; NULL for items without a section or submenu link
+    QVector<MenuNode*> m_children;
+    // decoded attributes, in the same slots as m_children
+    QVector<ItemCache> m_cache;
     MenuNode* m_parent;
+    int m_position;
+    int m_depth;
     int m_size;
     QObject *m_listener;
+    MenuNodeIndex *m_index;
     gulong m_signalChangedId;
     QString m_linkType;
     int m_currentOpPosition;
     int m_currentOpAdded;
     int m_currentOpRemoved;
+    bool m_populated;
+    qint64 m_lastAccess;
+
+    void removeChildren(int start, int count);
+    void insertChildren(int start, int count);
+    void updatePositions(int start);
 
     static void onItemsChanged(GMenuModel *model, gint position, gint removed, gint added, gpointer data);
 };
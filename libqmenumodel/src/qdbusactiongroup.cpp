@@ -21,6 +21,7 @@
 #include "qdbusactiongroup.h"
 #include "qstateaction.h"
 #include "converter.h"
+#include "stringcache.h"
 #include "qmenumodelevents.h"
 
 // Qt
@@ -60,7 +61,8 @@ QDBusActionGroup::QDBusActionGroup(QObject *parent)
     :QObject(parent),
      QDBusObject(this),
      m_actionGroup(NULL),
-     m_actionStateParser(new ActionStateParser(this))
+     m_actionStateParser(new ActionStateParser(this)),
+     m_actionsChangedPosted(false)
 {
 }
 
@@ -68,6 +70,10 @@ QDBusActionGroup::QDBusActionGroup(QObject *parent)
 QDBusActionGroup::~QDBusActionGroup()
 {
     clear();
+
+    // delete the actions while the index they leave is still alive
+    QList<QStateAction*> actions = m_actions.values();
+    qDeleteAll(actions);
 }
 
 QStringList QDBusActionGroup::actions() const
@@ -76,7 +82,7 @@ QStringList QDBusActionGroup::actions() const
     QStringList list;
     gchar** actions = g_action_group_list_actions(m_actionGroup);
     for (uint i = 0; actions[i]; i++) {
-        list << QString(actions[i]);
+        list << StringCache::intern(actions[i]);
     }
     g_strfreev(actions);
     return list;
@@ -94,6 +100,7 @@ QStateAction *QDBusActionGroup::action(const QString &name)
     QStateAction *act = actionImpl(name);
     if (act == 0) {
         act = new QStateAction(this, name);
+        m_actions.insert(name, act);
     }
 
     return act;
@@ -101,26 +108,38 @@ QStateAction *QDBusActionGroup::action(const QString &name)
 
 QVariant QDBusActionGroup::actionState(const QString &name)
 {
-    QVariant result;
-    GVariant *state = g_action_group_get_action_state(m_actionGroup, name.toUtf8().data());
-
-    if (m_actionStateParser != NULL) {
-        result = m_actionStateParser->toQVariant(state);
-    } else {
-        result = Converter::toQVariant(state);
+    // answered locally once known, action-state-changed keeps it current
+    QHash<QString, QVariant>::const_iterator it = m_states.constFind(name);
+    if (it != m_states.constEnd()) {
+        return it.value();
     }
 
+    GVariant *state = g_action_group_get_action_state(m_actionGroup, utf8Name(name).constData());
+    QVariant result = parseState(state);
+
     if (state) {
         g_variant_unref(state);
     }
+    if (m_actionGroup) {
+        m_states.insert(name, result);
+    }
     return result;
 }
 
+/*! \internal */
+QVariant QDBusActionGroup::parseState(GVariant *state) const
+{
+    if (m_actionStateParser != NULL) {
+        return m_actionStateParser->toQVariant(state);
+    }
+    return Converter::toQVariant(state);
+}
+
 
 bool QDBusActionGroup::hasAction(const QString &name)
 {
     if (m_actionGroup) {
-        return g_action_group_has_action(m_actionGroup, name.toUtf8().data());
+        return g_action_group_has_action(m_actionGroup, utf8Name(name).constData());
     } else {
         return false;
     }
@@ -128,12 +147,60 @@ bool QDBusActionGroup::hasAction(const QString &name)
 
 QStateAction *QDBusActionGroup::actionImpl(const QString &name)
 {
-    Q_FOREACH(QStateAction *act, this->findChildren<QStateAction*>()) {
-        if (act->name() == name) {
-            return act;
+    return m_actions.value(name);
+}
+
+/*! \internal */
+void QDBusActionGroup::removeAction(QStateAction *action)
+{
+    QHash<QString, QStateAction*>::iterator it = m_actions.find(action->name());
+    if ((it != m_actions.end()) && (it.value() == action)) {
+        m_actions.erase(it);
+    }
+}
+
+/*! \internal
+    Returns \a name in UTF-8, reusing the encoded name of an existing
+    action instead of converting again.
+*/
+QByteArray QDBusActionGroup::utf8Name(const QString &name) const
+{
+    QStateAction *act = m_actions.value(name);
+    return act ? act->m_utf8Name : name.toUtf8();
+}
+
+/*! \internal
+    Tells the indexed action and the listeners that \a name appeared or
+    vanished. actionsChanged is left to queueActionsChanged().
+*/
+void QDBusActionGroup::setActionVisible(const QString &name, bool visible)
+{
+    QStateAction *act = actionImpl(name);
+    m_states.remove(name);
+
+    if (visible) {
+        if (act) {
+            act->onActionAppear(name);
+        }
+        Q_EMIT actionAppear(name);
+    } else {
+        if (act) {
+            act->onActionVanish(name);
         }
+        Q_EMIT actionVanish(name);
+    }
+}
+
+/*! \internal
+    Schedules a single actionsChanged for the next event loop turn, so a
+    whole burst of added or removed actions costs one binding update.
+*/
+void QDBusActionGroup::queueActionsChanged()
+{
+    if (!m_actionsChangedPosted) {
+        m_actionsChangedPosted = true;
+        QCoreApplication::postEvent(this, new DBusActionsChangedEvent);
     }
-    return 0;
 }
 
 /*! \internal */
@@ -202,11 +269,11 @@ void QDBusActionGroup::setActionGroup(GDBusActionGroup *ag)
                                                    this);
 
         gchar **actions = g_action_group_list_actions(m_actionGroup);
-        for(guint i=0; i < g_strv_length(actions); i++) {
-            DBusActionVisiblityEvent dave(actions[i], true);
-            QCoreApplication::sendEvent(this, &dave);
+        for (guint i = 0; actions[i]; i++) {
+            setActionVisible(StringCache::intern(actions[i]), true);
         }
         g_strfreev(actions);
+        queueActionsChanged();
     }
 }
 
@@ -219,6 +286,7 @@ void QDBusActionGroup::setActionStateParser(ActionStateParser* actionStateParser
 {
     if (m_actionStateParser != actionStateParser) {
         m_actionStateParser = actionStateParser;
+        m_states.clear();
         Q_EMIT actionStateParserChanged(actionStateParser);
     }
 }
@@ -232,14 +300,17 @@ void QDBusActionGroup::clear()
         g_signal_handler_disconnect(m_actionGroup, m_signalStateChangedId);
         m_signalActionAddId = m_signalActionRemovedId = m_signalStateChangedId = 0;
     }
+    m_states.clear();
 
-    Q_FOREACH(QStateAction *act, this->findChildren<QStateAction*>()) {
+    Q_FOREACH(QStateAction *act, m_actions) {
+        act->onActionVanish(act->name());
         Q_EMIT actionVanish(act->name());
     }
 
     if (m_actionGroup != NULL) {
         g_object_unref(m_actionGroup);
         m_actionGroup = NULL;
+        queueActionsChanged();
     }
 }
 
@@ -247,14 +318,14 @@ void QDBusActionGroup::clear()
 void QDBusActionGroup::updateActionState(const QString &name, const QVariant &state)
 {
     if (m_actionGroup != NULL) {
-        g_action_group_change_action_state(m_actionGroup, name.toUtf8().data(), Converter::toGVariant(state));
+        g_action_group_change_action_state(m_actionGroup, utf8Name(name).constData(), Converter::toGVariant(state));
     }
 }
 
 void QDBusActionGroup::activateAction(const QString &name, const QVariant &parameter)
 {
     if (m_actionGroup != NULL) {
-        g_action_group_activate_action(m_actionGroup, name.toUtf8().data(), Converter::toGVariant(parameter));
+        g_action_group_activate_action(m_actionGroup, utf8Name(name).constData(), Converter::toGVariant(parameter));
     }
 }
 
@@ -265,15 +336,20 @@ bool QDBusActionGroup::event(QEvent* e)
     } else if (e->type() == DBusActionVisiblityEvent::eventType) {
         DBusActionVisiblityEvent *dave = static_cast<DBusActionVisiblityEvent*>(e);
 
-        if (dave->visible) {
-            Q_EMIT actionAppear(dave->name);
-        } else {
-            Q_EMIT actionVanish(dave->name);
-        }
+        setActionVisible(dave->name, dave->visible);
+        queueActionsChanged();
+    } else if (e->type() == DBusActionsChangedEvent::eventType) {
+        // reset first, a listener may change the group again
+        m_actionsChangedPosted = false;
         Q_EMIT actionsChanged();
+        return true;
     } else if (e->type() == DBusActionStateEvent::eventType) {
         DBusActionStateEvent *dase = static_cast<DBusActionStateEvent*>(e);
+        QStateAction *act = actionImpl(dase->name);
 
+        if (act) {
+            act->onActionStateChanged(dase->name, dase->state);
+        }
         Q_EMIT actionStateChanged(dase->name, dase->state);
     }
     return QObject::event(e);
@@ -284,7 +360,7 @@ void QDBusActionGroup::onActionAdded(GDBusActionGroup *, gchar *name, gpointer d
 {
     QDBusActionGroup *self = reinterpret_cast<QDBusActionGroup*>(data);
 
-    DBusActionVisiblityEvent dave(name, true);
+    DBusActionVisiblityEvent dave(StringCache::intern(name), true);
     QCoreApplication::sendEvent(self, &dave);
 }
 
@@ -293,7 +369,7 @@ void QDBusActionGroup::onActionRemoved(GDBusActionGroup *, gchar *name, gpointer
 {
     QDBusActionGroup *self = reinterpret_cast<QDBusActionGroup*>(data);
 
-    DBusActionVisiblityEvent dave(name, false);
+    DBusActionVisiblityEvent dave(StringCache::intern(name), false);
     QCoreApplication::sendEvent(self, &dave);
 }
 
@@ -301,7 +377,12 @@ void QDBusActionGroup::onActionRemoved(GDBusActionGroup *, gchar *name, gpointer
 void QDBusActionGroup::onActionStateChanged(GDBusActionGroup *, gchar *name, GVariant *value, gpointer data)
 {
     QDBusActionGroup *self = reinterpret_cast<QDBusActionGroup*>(data);
+    QString actionName = StringCache::intern(name);
+    QVariant state = self->parseState(value);
+
+    // the cache and the listeners get the same parsed value
+    self->m_states.insert(actionName, state);
 
-    DBusActionStateEvent dase(name, Converter::toQVariant(value));
+    DBusActionStateEvent dase(actionName, state);
     QCoreApplication::sendEvent(self, &dase);
 }
@@ -22,6 +22,7 @@
 
 #include "qdbusobject.h"
 
+#include <QHash>
 #include <QObject>
 #include <QVariant>
 
@@ -88,12 +89,20 @@ private:
     int m_signalStateChangedId;
 
     ActionStateParser* m_actionStateParser;
+    QHash<QString, QStateAction*> m_actions;
+    bool m_actionsChangedPosted;
+    QHash<QString, QVariant> m_states;
 
     // workaround to support int as busType
     void setIntBusType(int busType);
 
     void setActionGroup(GDBusActionGroup *ag);
     QStateAction *actionImpl(const QString &name);
+    void removeAction(QStateAction *action);
+    QByteArray utf8Name(const QString &name) const;
+    void setActionVisible(const QString &name, bool visible);
+    void queueActionsChanged();
+    QVariant parseState(GVariant *state) const;
 
     void clear();
 
@@ -101,6 +110,8 @@ private:
     static void onActionAdded(GDBusActionGroup *ag, gchar *name, gpointer data);
     static void onActionRemoved(GDBusActionGroup *ag, gchar *name, gpointer data);
     static void onActionStateChanged(GDBusActionGroup *ag, gchar *name, GVariant *value, gpointer data);
+
+    friend class QStateAction;
 };
 
 #endif // QDBUSACTIONGROUP_H
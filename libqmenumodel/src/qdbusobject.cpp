@@ -27,6 +27,135 @@ extern "C" {
 
 #include <QDebug>
 #include <QCoreApplication>
+#include <QHash>
+#include <QPair>
+
+typedef QPair<int, QByteArray> NameWatchKey;
+typedef QHash<NameWatchKey, NameWatch*> NameWatchRegistry;
+
+// GUI thread only
+Q_GLOBAL_STATIC(NameWatchRegistry, nameWatches)
+
+/*! \internal
+    One bus name watch shared by every QDBusObject following the same
+    (bus, name) pair, e.g. the menus and action groups of one application.
+    The GLib side reports to it, and it fans each owner change out to all
+    of its listeners at once. It lives while it has listeners.
+*/
+class NameWatch : public QObject
+{
+public:
+    static NameWatch *subscribe(GBusType type, const QByteArray &name, QObject *listener);
+    static void unsubscribe(NameWatch *watch, QObject *listener);
+
+protected:
+    bool event(QEvent *e);
+
+private:
+    NameWatch(GBusType type, const QByteArray &name);
+    ~NameWatch();
+
+    static const QEvent::Type replayEventType;
+
+    NameWatchKey m_key;
+    guint m_watchId;
+    QList<QObject*> m_listeners;
+    QList<QObject*> m_pending;
+    GDBusConnection *m_connection;
+};
+
+const QEvent::Type NameWatch::replayEventType = static_cast<QEvent::Type>(QEvent::registerEventType());
+
+NameWatch::NameWatch(GBusType type, const QByteArray &name)
+    : m_key(type, name),
+      m_connection(NULL)
+{
+    m_watchId = g_bus_watch_name (type,
+                                  name.constData(),
+                                  G_BUS_NAME_WATCHER_FLAGS_AUTO_START,
+                                  QDBusObject::onServiceAppeared,
+                                  QDBusObject::onServiceVanished,
+                                  this,
+                                  NULL);
+}
+
+NameWatch::~NameWatch()
+{
+    g_bus_unwatch_name (m_watchId);
+    if (m_connection) {
+        g_object_unref(m_connection);
+    }
+}
+
+/*! \internal
+    Adds \a listener to the watch for \a name on \a type, starting one
+    if nobody follows that name yet. A listener joining a name that is
+    already owned is told so on the next event loop turn.
+*/
+NameWatch *NameWatch::subscribe(GBusType type, const QByteArray &name, QObject *listener)
+{
+    NameWatch *&watch = (*nameWatches())[NameWatchKey(type, name)];
+    if (watch == 0) {
+        watch = new NameWatch(type, name);
+    } else if (watch->m_connection) {
+        if (watch->m_pending.isEmpty()) {
+            QCoreApplication::postEvent(watch, new QEvent(replayEventType));
+        }
+        watch->m_pending << listener;
+    }
+    watch->m_listeners << listener;
+    return watch;
+}
+
+/*! \internal
+    Removes \a listener, and stops the watch with its last listener.
+*/
+void NameWatch::unsubscribe(NameWatch *watch, QObject *listener)
+{
+    watch->m_listeners.removeOne(listener);
+    watch->m_pending.removeOne(listener);
+
+    if (watch->m_listeners.isEmpty()) {
+        nameWatches()->remove(watch->m_key);
+        // it may be in the middle of a fan out
+        watch->deleteLater();
+    }
+}
+
+bool NameWatch::event(QEvent *e)
+{
+    if (e->type() == DbusObjectServiceEvent::eventType) {
+        DbusObjectServiceEvent *dose = static_cast<DbusObjectServiceEvent*>(e);
+        GDBusConnection *old = m_connection;
+        m_connection = dose->visible ? G_DBUS_CONNECTION(g_object_ref(dose->connection)) : NULL;
+        if (old) {
+            g_object_unref(old);
+        }
+
+        // everybody hears this one, no need to replay to them
+        m_pending.clear();
+
+        // listeners may come and go while they handle it
+        QList<QObject*> listeners = m_listeners;
+        Q_FOREACH(QObject *listener, listeners) {
+            if (m_listeners.contains(listener)) {
+                QCoreApplication::sendEvent(listener, dose);
+            }
+        }
+        return true;
+    } else if (e->type() == replayEventType) {
+        QList<QObject*> pending = m_pending;
+        m_pending.clear();
+        Q_FOREACH(QObject *listener, pending) {
+            if (m_connection && m_listeners.contains(listener)) {
+                DbusObjectServiceEvent dose(m_connection, true);
+                QCoreApplication::sendEvent(listener, &dose);
+            }
+        }
+        return true;
+    }
+    return QObject::event(e);
+}
 
 /*!
     \qmltype QDBusObject
@@ -77,7 +206,7 @@ extern "C" {
 
 QDBusObject::QDBusObject(QObject* listener)
     :m_listener(listener),
-     m_watchId(0),
+     m_watch(0),
      m_busType(DBusEnums::None),
      m_status(DBusEnums::Disconnected)
 {
@@ -86,10 +215,7 @@ QDBusObject::QDBusObject(QObject* listener)
 
 QDBusObject::~QDBusObject()
 {
-    if (m_watchId != 0) {
-        g_bus_unwatch_name (m_watchId);
-        m_watchId = 0;
-    }
+    stopWatch();
 }
 
 DBusEnums::BusType QDBusObject::busType() const
@@ -155,14 +281,9 @@ void QDBusObject::connect()
     if (m_status != DBusEnums::Disconnected) {
         return;
     } else if ((m_busType > DBusEnums::None) && !m_objectPath.isEmpty() && !m_busName.isEmpty()) {
-        GBusType type = m_busType == DBusEnums::SessionBus ? G_BUS_TYPE_SESSION : G_BUS_TYPE_SYSTEM;
-        m_watchId = g_bus_watch_name (type,
-                                      m_busName.toUtf8().data(),
-                                      G_BUS_NAME_WATCHER_FLAGS_AUTO_START,
-                                      QDBusObject::onServiceAppeared,
-                                      QDBusObject::onServiceVanished,
-                                      this,
-                                      NULL);
+        m_watch = NameWatch::subscribe(m_busType == DBusEnums::SessionBus ? G_BUS_TYPE_SESSION : G_BUS_TYPE_SYSTEM,
+                                       m_busName.toUtf8(),
+                                       m_listener);
 
         setStatus(DBusEnums::Connecting);
     } else {
@@ -173,30 +294,33 @@ void QDBusObject::connect()
 void QDBusObject::disconnect()
 {
     if (m_status != DBusEnums::Disconnected) {
-        g_bus_unwatch_name (m_watchId);
-        m_watchId = 0;
+        stopWatch();
         setStatus(DBusEnums::Disconnected);
     }
 }
 
+void QDBusObject::stopWatch()
+{
+    if (m_watch) {
+        NameWatch::unsubscribe(m_watch, m_listener);
+        m_watch = 0;
+    }
+}
+
 void QDBusObject::onServiceAppeared(GDBusConnection *connection, const gchar *, const gchar *, gpointer data)
 {
-    QDBusObject *self = reinterpret_cast<QDBusObject*>(data);
+    NameWatch *watch = reinterpret_cast<NameWatch*>(data);
 
-    if (self->m_listener) {
-        DbusObjectServiceEvent dose(connection, true);
-        QCoreApplication::sendEvent(self->m_listener, &dose);
-    }
+    DbusObjectServiceEvent dose(connection, true);
+    QCoreApplication::sendEvent(watch, &dose);
 }
 
 void QDBusObject::onServiceVanished(GDBusConnection *connection, const gchar *, gpointer data)
 {
-    QDBusObject *self = reinterpret_cast<QDBusObject*>(data);
+    NameWatch *watch = reinterpret_cast<NameWatch*>(data);
 
-    if (self->m_listener) {
-        DbusObjectServiceEvent dose(connection, false);
-        QCoreApplication::sendEvent(self->m_listener, &dose);
-    }
+    DbusObjectServiceEvent dose(connection, false);
+    QCoreApplication::sendEvent(watch, &dose);
 }
 
 bool QDBusObject::event(QEvent* e)
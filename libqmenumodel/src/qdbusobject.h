@@ -28,6 +28,7 @@ typedef unsigned int guint;
 typedef char gchar;
 typedef void* gpointer;
 typedef struct _GDBusConnection GDBusConnection;
+class NameWatch;
 
 class QDBusObject
 {
@@ -64,7 +65,7 @@ protected:
 
 private:
     QObject* m_listener;
-    guint m_watchId;
+    NameWatch *m_watch;
     DBusEnums::BusType m_busType;
     QString m_busName;
     QString m_objectPath;
@@ -72,6 +73,10 @@ private:
 
     void setStatus(DBusEnums::ConnectionStatus status);
 
+    void stopWatch();
+
+    friend class NameWatch;
+
     // glib slots
     static void onServiceAppeared(GDBusConnection *connection, const gchar *name, const gchar *name_owner, gpointer data);
     static void onServiceVanished(GDBusConnection *connection, const gchar *name, gpointer data);
@@ -25,6 +25,7 @@ extern "C" {
 #include "qmenumodel.h"
 #include "menunode.h"
 #include "converter.h"
+#include "stringcache.h"
 #include "qmenumodelevents.h"
 
 #include <QCoreApplication>
@@ -41,8 +42,11 @@ extern "C" {
 /*! \internal */
 QMenuModel::QMenuModel(GMenuModel *other, QObject *parent)
     : QAbstractItemModel(parent),
-      m_root(0)
+      m_root(0),
+      m_idleReleaseInterval(0)
 {
+    m_clock.start();
+    QObject::connect(&m_releaseTimer, SIGNAL(timeout()), this, SLOT(releaseIdleNodes()));
     setMenuModel(other);
 }
 
@@ -64,7 +68,7 @@ void QMenuModel::setMenuModel(GMenuModel *other)
     clearModel();
 
     if (other) {
-        m_root = new MenuNode("", other, 0, 0, this);
+        m_root = new MenuNode("", other, 0, 0, this, &m_nodes);
     }
 
     endResetModel();
@@ -77,6 +81,7 @@ void QMenuModel::clearModel()
         delete m_root;
         m_root = NULL;
     }
+    m_nodes.clear();
 }
 
 /*! \internal */
@@ -97,17 +102,10 @@ QHash<int, QByteArray> QMenuModel::roleNames() const
 /*! \internal */
 QModelIndex QMenuModel::index(int row, int column, const QModelIndex &parent) const
 {
-    MenuNode *node = nodeFromIndex(parent);
+    MenuNode *node = parent.isValid() ? linkedChild(parent) : m_root;
     if (node == 0) {
         return QModelIndex();
     }
-
-    if (parent.isValid()) {
-        MenuNode *child = node->child(parent.row());
-        if (child) {
-            node = child;
-        }
-    }
     return createIndex(row, column, node);
 }
 
@@ -135,17 +133,21 @@ QVariant QMenuModel::data(const QModelIndex &index, int role) const
     MenuNode *node = nodeFromIndex(index);
     int row = node ? node->realPosition(index.row()) : -1;
 
+    if (node && (m_idleReleaseInterval > 0)) {
+        node->touch(m_clock.elapsed());
+    }
+
     if (row >= 0) {
         switch (role) {
         case Action:
-            attribute = getStringAttribute(node, row, G_MENU_ATTRIBUTE_ACTION);
+            attribute = getCachedAttribute(node, index.row(), row, MenuNode::ActionAttribute);
             break;
         case Qt::DisplayRole:
         case Label:
-            attribute = getStringAttribute(node, row, G_MENU_ATTRIBUTE_LABEL);
+            attribute = getCachedAttribute(node, index.row(), row, MenuNode::LabelAttribute);
             break;
         case Extra:
-            attribute = getExtraProperties(node, row);
+            attribute = getCachedAttribute(node, index.row(), row, MenuNode::ExtraAttribute);
             break;
         case hasSection:
             attribute = QVariant(hasLink(node, row, G_MENU_LINK_SECTION));
@@ -163,18 +165,15 @@ QVariant QMenuModel::data(const QModelIndex &index, int role) const
     return attribute;
 }
 
-/*! \internal */
+/*! \internal
+    Links that were not fetched yet have no rows; views get them through
+    fetchMore().
+*/
 int QMenuModel::rowCount(const QModelIndex &index) const
 {
     if (index.isValid()) {
-        MenuNode *node = nodeFromIndex(index);
-        if (node) {
-            MenuNode *child = node->child(index.row());
-            if (child) {
-                return child->size();
-            }
-        }
-        return 0;
+        MenuNode *child = linkedChild(index);
+        return child ? child->size() : 0;
     }
     if (m_root) {
         return m_root->size();
@@ -182,26 +181,105 @@ int QMenuModel::rowCount(const QModelIndex &index) const
     return 0;
 }
 
+/*! \internal
+    Answers without populating the row, so views can draw expanders for
+    links that have not been opened yet.
+*/
+bool QMenuModel::hasChildren(const QModelIndex &index) const
+{
+    if (index.isValid()) {
+        MenuNode *node = nodeFromIndex(index);
+        MenuNode *child = node ? node->child(index.row()) : 0;
+        if (child == 0) {
+            return false;
+        }
+        return !child->isPopulated() || (child->size() > 0);
+    }
+    return (m_root != 0) && (m_root->size() > 0);
+}
+
+/*! \internal */
+bool QMenuModel::canFetchMore(const QModelIndex &parent) const
+{
+    MenuNode *child = parent.isValid() ? linkedChild(parent) : 0;
+    return child && !child->isPopulated();
+}
+
+/*! \internal
+    Reads the items linked at \a parent, announcing them as inserted rows.
+*/
+void QMenuModel::fetchMore(const QModelIndex &parent)
+{
+    MenuNode *child = parent.isValid() ? linkedChild(parent) : 0;
+    if ((child == 0) || child->isPopulated()) {
+        return;
+    }
+
+    if (m_idleReleaseInterval > 0) {
+        child->touch(m_clock.elapsed());
+    }
+
+    const int count = g_menu_model_get_n_items(child->model());
+    if (count > 0) {
+        beginInsertRows(parent, 0, count - 1);
+        child->populate();
+        endInsertRows();
+    } else {
+        child->populate();
+    }
+}
+
 /*! \internal */
 int QMenuModel::columnCount(const QModelIndex &) const
 {
     return 1;
 }
 
+/*! \internal
+    Returns \a attribute of the item the view knows as \a slot, which the
+    menu model currently has at \a row. Values are decoded from GLib once
+    and then served from the node's cache.
+*/
+QVariant QMenuModel::getCachedAttribute(MenuNode *node, int slot, int row, int attribute) const
+{
+    QVariant result;
+    MenuNode::CachedAttribute cached = static_cast<MenuNode::CachedAttribute>(attribute);
+    if (node->cachedAttribute(slot, cached, &result)) {
+        return result;
+    }
+
+    switch (cached) {
+    case MenuNode::LabelAttribute:
+        result = getStringAttribute(node, row, G_MENU_ATTRIBUTE_LABEL);
+        break;
+    case MenuNode::ActionAttribute:
+        result = getStringAttribute(node, row, G_MENU_ATTRIBUTE_ACTION, InternedString);
+        break;
+    case MenuNode::ExtraAttribute:
+        result = getExtraProperties(node, row);
+        break;
+    }
+
+    node->cacheAttribute(slot, cached, result);
+    return result;
+}
+
 /*! \internal */
 QVariant QMenuModel::getStringAttribute(MenuNode *node,
                                         int row,
-                                        const QString &attribute) const
+                                        const char *attribute,
+                                        StringStorage storage) const
 {
     QVariant result;
-    gchar* value = NULL;
-    g_menu_model_get_item_attribute(node->model(),
-                                    row,
-                                    attribute.toUtf8().data(),
-                                    "s", &value);
+    GVariant *value = g_menu_model_get_item_attribute_value(node->model(),
+                                                            row,
+                                                            attribute,
+                                                            G_VARIANT_TYPE_STRING);
     if (value) {
-        result = QVariant(QString::fromUtf8(value));
-        g_free(value);
+        gsize size = 0;
+        const gchar *str = g_variant_get_string(value, &size);
+        result = storage == InternedString ? StringCache::intern(str) : QString::fromUtf8(str, size);
+        g_variant_unref(value);
     }
     return result;
 }
@@ -219,10 +297,12 @@ QVariant QMenuModel::getExtraProperties(MenuNode *node, int row) const
     GVariant *value = NULL;
     while (g_menu_attribute_iter_get_next (iter, &attrName, &value)) {
         if (strncmp("x-", attrName, 2) == 0) {
-            extra.insert(parseExtraPropertyName(attrName),
+            extra.insert(extraPropertyName(attrName),
                          Converter::toQVariant(value));
         }
+        g_variant_unref(value);
     }
+    g_object_unref(iter);
 
     return extra;
 }
@@ -236,7 +316,7 @@ bool QMenuModel::event(QEvent* e)
         if (mnice->removed > 0) {
             beginRemoveRows(index, mnice->position, mnice->position + mnice->removed - 1);
 
-            mnice->node->commitOperation();
+            mnice->node->commitRemoval();
 
             endRemoveRows();
         }
@@ -244,7 +324,7 @@ bool QMenuModel::event(QEvent* e)
         if (mnice->added > 0) {
             beginInsertRows(index, mnice->position, mnice->position + mnice->added - 1);
 
-            mnice->node->commitOperation();
+            mnice->node->commitInsertion();
 
             endInsertRows();
         }
@@ -266,7 +346,16 @@ QModelIndex QMenuModel::indexFromNode(MenuNode *node) const
     if (node == m_root) {
         return QModelIndex();
     }
-    return createIndex(node->position(), 0, node);
+    return createIndex(node->position(), 0, node->parent());
+}
+
+/*! \internal
+    Returns the node linked at \a index, populated or not.
+*/
+MenuNode *QMenuModel::linkedChild(const QModelIndex &index) const
+{
+    MenuNode *node = nodeFromIndex(index);
+    return node ? node->child(index.row()) : 0;
 }
 
 /*! \internal */
@@ -283,6 +372,22 @@ MenuNode *QMenuModel::nodeFromIndex(const QModelIndex &index) const
     return node;
 }
 
+/*! \internal
+    Returns the parsed name of the 'x-' attribute \a attrName, parsing each
+    distinct attribute only once.
+*/
+QString QMenuModel::extraPropertyName(const char *attrName) const
+{
+    GQuark quark = g_quark_from_string(attrName);
+    QHash<quint32, QString>::const_iterator it = m_extraPropertyNames.constFind(quark);
+    if (it != m_extraPropertyNames.constEnd()) {
+        return it.value();
+    }
+    QString name = parseExtraPropertyName(StringCache::intern(quark));
+    m_extraPropertyNames.insert(quark, name);
+    return name;
+}
+
 /*! \internal */
 QString QMenuModel::parseExtraPropertyName(const QString &name) const
 {
@@ -293,6 +398,84 @@ QString QMenuModel::parseExtraPropertyName(const QString &name) const
     return newName.replace("-", "_");
 }
 
+/*!
+    \qmlproperty int QMenuModel::idleReleaseInterval
+    Time in milliseconds after which the items of a submenu or section
+    nobody looked at are dropped again. They are read back from the menu
+    model on the next access. 0, the default, keeps them forever.
+*/
+int QMenuModel::idleReleaseInterval() const
+{
+    return m_idleReleaseInterval;
+}
+
+void QMenuModel::setIdleReleaseInterval(int interval)
+{
+    interval = qMax(0, interval);
+    if (m_idleReleaseInterval == interval) {
+        return;
+    }
+
+    m_idleReleaseInterval = interval;
+    if (interval > 0) {
+        m_releaseTimer.start(interval);
+    } else {
+        m_releaseTimer.stop();
+    }
+    Q_EMIT idleReleaseIntervalChanged(interval);
+}
+
+/*! \internal */
+void QMenuModel::releaseIdleNodes()
+{
+    if (m_root) {
+        releaseIdleChildren(m_root, m_clock.elapsed() - m_idleReleaseInterval, heldNodes());
+    }
+}
+
+/*! \internal
+    Returns the nodes some view still holds a persistent index into, or
+    to, such as the expanded rows of a tree view, with their ancestors.
+*/
+QSet<MenuNode*> QMenuModel::heldNodes() const
+{
+    QSet<MenuNode*> held;
+    Q_FOREACH(const QModelIndex &index, persistentIndexList()) {
+        MenuNode *child = linkedChild(index);
+        if (child) {
+            held.insert(child);
+        }
+        for (MenuNode *node = nodeFromIndex(index); node; node = node->parent()) {
+            held.insert(node);
+        }
+    }
+    return held;
+}
+
+/*! \internal
+    Releases every populated child of \a node last used before
+    \a threshold and not \a held by a view, and recurses into the others.
+*/
+void QMenuModel::releaseIdleChildren(MenuNode *node, qint64 threshold, const QSet<MenuNode*> &held)
+{
+    for (int i = 0, iMax = node->size(); i < iMax; i++) {
+        MenuNode *child = node->child(i);
+        if ((child == 0) || !child->isPopulated()) {
+            continue;
+        }
+
+        if ((child->lastAccess() >= threshold) || held.contains(child)) {
+            releaseIdleChildren(child, threshold, held);
+        } else if (child->size() > 0) {
+            beginRemoveRows(createIndex(i, 0, node), 0, child->size() - 1);
+            child->release();
+            endRemoveRows();
+        } else {
+            child->release();
+        }
+    }
+}
+
 GMenuModel *QMenuModel::menuModel() const
 {
     return m_root->model();
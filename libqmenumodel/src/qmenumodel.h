@@ -21,6 +21,9 @@
 #define QMENUTREEMODEL_H
 
 #include <QAbstractItemModel>
+#include <QElapsedTimer>
+#include <QSet>
+#include <QTimer>
 
 class MenuNode;
 typedef struct _GMenuModel GMenuModel;
@@ -28,6 +31,7 @@ typedef struct _GMenuModel GMenuModel;
 class QMenuModel : public QAbstractItemModel
 {
     Q_OBJECT
+    Q_PROPERTY(int idleReleaseInterval READ idleReleaseInterval WRITE setIdleReleaseInterval NOTIFY idleReleaseIntervalChanged)
 
 public:
     enum MenuRoles {
@@ -47,10 +51,17 @@ public:
     QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
     QModelIndex index(int row, int column = 0, const QModelIndex &parent = QModelIndex()) const;
     QModelIndex parent(const QModelIndex &index) const;
+    bool hasChildren(const QModelIndex &parent = QModelIndex()) const;
+    bool canFetchMore(const QModelIndex &parent) const;
+    void fetchMore(const QModelIndex &parent);
     QHash<int, QByteArray> roleNames() const;
 
+    int idleReleaseInterval() const;
+    void setIdleReleaseInterval(int interval);
+
 Q_SIGNALS:
     void countChanged();
+    void idleReleaseIntervalChanged(int interval);
 
 protected:
     QMenuModel(GMenuModel *other=0, QObject *parent=0);
@@ -59,16 +70,36 @@ protected:
 
     virtual bool event(QEvent* e);
 
+private Q_SLOTS:
+    void releaseIdleNodes();
+
 private:
     MenuNode *m_root;
+    QHash<GMenuModel*, MenuNode*> m_nodes;
+    int m_idleReleaseInterval;
+    QTimer m_releaseTimer;
+    QElapsedTimer m_clock;
+    mutable QHash<quint32, QString> m_extraPropertyNames;
 
     MenuNode* nodeFromIndex(const QModelIndex &index) const;
     QModelIndex indexFromNode(MenuNode *node) const;
+    MenuNode *linkedChild(const QModelIndex &index) const;
+    QSet<MenuNode*> heldNodes() const;
+    void releaseIdleChildren(MenuNode *node, qint64 threshold, const QSet<MenuNode*> &held);
+
+    QVariant getCachedAttribute(MenuNode *node, int slot, int row, int attribute) const;
+    // InternedString shares the QString through StringCache, for
+    // identifiers such as action names; never for free text
+    enum StringStorage {
+        CopiedString,
+        InternedString
+    };
 
-    QVariant getStringAttribute(MenuNode *node, int row, const QString &attribute) const;
+    QVariant getStringAttribute(MenuNode *node, int row, const char *attribute, StringStorage storage = CopiedString) const;
     QVariant getExtraProperties(MenuNode *node, int row) const;
     bool hasLink(MenuNode *node, int row, const QString &linkType) const;
 
+    QString extraPropertyName(const char *attrName) const;
     QString parseExtraPropertyName(const QString &name) const;
     void clearModel();
 };
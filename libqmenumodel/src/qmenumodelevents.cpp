@@ -27,6 +27,7 @@ extern "C" {
 const QEvent::Type MenuNodeItemChangeEvent::eventType = static_cast<QEvent::Type>(QEvent::registerEventType());
 const QEvent::Type DBusActionStateEvent::eventType = static_cast<QEvent::Type>(QEvent::registerEventType());
 const QEvent::Type DBusActionVisiblityEvent::eventType = static_cast<QEvent::Type>(QEvent::registerEventType());
+const QEvent::Type DBusActionsChangedEvent::eventType = static_cast<QEvent::Type>(QEvent::registerEventType());
 const QEvent::Type MenuModelEvent::eventType = static_cast<QEvent::Type>(QEvent::registerEventType());
 const QEvent::Type DbusObjectServiceEvent::eventType = static_cast<QEvent::Type>(QEvent::registerEventType());
 
@@ -53,6 +54,12 @@ DBusActionVisiblityEvent::DBusActionVisiblityEvent(const QString& _name, bool _v
 }
 
 
+DBusActionsChangedEvent::DBusActionsChangedEvent()
+    : QEvent(DBusActionsChangedEvent::eventType)
+{
+}
+
+
 DBusActionStateEvent::DBusActionStateEvent(const QString& _name, const QVariant& _state)
     : DBusActionEvent(_name, DBusActionStateEvent::eventType),
       state(_state)
@@ -71,6 +71,14 @@ public:
     bool visible;
 };
 
+/* Event flushing the action list changes queued for a dbus action group */
+class DBusActionsChangedEvent : public QEvent
+{
+public:
+    static const QEvent::Type eventType;
+    DBusActionsChangedEvent();
+};
+
 /* Event for a GAction state value update */
 class DBusActionStateEvent : public DBusActionEvent
 {
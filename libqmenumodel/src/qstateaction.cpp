@@ -50,25 +50,23 @@
 QStateAction::QStateAction(QDBusActionGroup *group, const QString &name)
     : QObject(group),
       m_group(group),
-      m_name(name)
+      m_name(name),
+      m_utf8Name(name.toUtf8())
 {
-    // This keep the code clean
-    // But maybe we need move the action state control to QActionGroup to optimizations
-    QObject::connect(m_group, SIGNAL(actionAppear(QString)),
-                     this, SLOT(onActionAppear(QString)));
-    QObject::connect(m_group, SIGNAL(actionVanish(QString)),
-                     this, SLOT(onActionVanish(QString)));
-    QObject::connect(m_group, SIGNAL(actionStateChanged(QString,QVariant)),
-                     this, SLOT(onActionStateChanged(QString,QVariant)));
-
-
-
+    // appear, vanish and state changes are dispatched to this action
+    // directly by the group, through its name index
     m_valid = m_group->hasAction(name);
     if (m_valid) {
         setState(m_group->actionState(name));
     }
 }
 
+/*! \internal */
+QStateAction::~QStateAction()
+{
+    m_group->removeAction(this);
+}
+
 /*!
     \qmlproperty int QStateAction::state
     This property holds the current action state
@@ -95,7 +93,7 @@ bool QStateAction::isValid() const
 void QStateAction::updateState(const QVariant &state)
 {
     QVariant v = state;
-    if (v.convert(m_state.type()))
+    if (v.convert(m_state.userType()))
       m_group->updateActionState(m_name, v);
 }
 
@@ -146,7 +144,7 @@ void QStateAction::setValid(bool valid)
 void QStateAction::setState(const QVariant &state)
 {
     QVariant v = state;
-    if (!m_state.isValid() || (v.convert(m_state.type()) && v != m_state)) {
+    if (!m_state.isValid() || (v.convert(m_state.userType()) && v != m_state)) {
         m_state = v;
         Q_EMIT stateChanged(m_state);
     }
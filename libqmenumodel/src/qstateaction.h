@@ -32,6 +32,8 @@ class QStateAction : public QObject
     Q_PROPERTY(QVariant state READ state NOTIFY stateChanged)
     Q_PROPERTY(bool valid READ isValid NOTIFY validChanged)
 public:
+    ~QStateAction();
+
     QVariant state() const;
     bool isValid() const;
 
@@ -54,6 +56,7 @@ private:
     QVariant m_state;
     bool m_valid;
     QString m_name;
+    QByteArray m_utf8Name;
 
     QStateAction(QDBusActionGroup *group, const QString &name);
 
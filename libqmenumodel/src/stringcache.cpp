@@ -0,0 +1,74 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+extern "C" {
+#include <glib.h>
+}
+
+#include "stringcache.h"
+
+#include <QReadWriteLock>
+#include <QString>
+#include <QVector>
+
+/*! \internal
+    GQuarks are allocated sequentially from 1, so the table is a plain
+    vector indexed by quark.
+*/
+class StringTable
+{
+public:
+    QString lookup(GQuark quark)
+    {
+        {
+            QReadLocker locker(&lock);
+            if (int(quark) < strings.size() && !strings.at(quark).isNull()) {
+                return strings.at(quark);
+            }
+        }
+
+        QWriteLocker locker(&lock);
+        if (int(quark) >= strings.size()) {
+            strings.resize(quark + 1);
+        }
+        if (strings.at(quark).isNull()) {
+            strings[quark] = QString::fromUtf8(g_quark_to_string(quark));
+        }
+        return strings.at(quark);
+    }
+
+private:
+    QReadWriteLock lock;
+    QVector<QString> strings;
+};
+Q_GLOBAL_STATIC(StringTable, stringTable)
+
+/*! \internal
+    Returns the shared QString for \a str, interning it as a GQuark.
+*/
+QString StringCache::intern(const char *str)
+{
+    if (str == NULL) {
+        return QString();
+    }
+    return intern(g_quark_from_string(str));
+}
+
+QString StringCache::intern(quint32 quark)
+{
+    if (quark == 0) {
+        return QString();
+    }
+    return stringTable()->lookup(quark);
+}
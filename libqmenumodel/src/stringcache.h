@@ -0,0 +1,34 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef STRINGCACHE_H
+#define STRINGCACHE_H
+
+#include <QtGlobal>
+
+class QString;
+
+// Shared QStrings for identifiers that repeat across a menu: action names,
+// attribute keys, item types. Entries are keyed by GQuark and live as long
+// as the process, so this must not be used for free text such as labels.
+// Quarks are passed as quint32, the type GQuark is defined as, so this
+// header does not need glib.h.
+class StringCache
+{
+public:
+    static QString intern(const char *str);
+    static QString intern(quint32 quark);
+};
+
+#endif // STRINGCACHE_H
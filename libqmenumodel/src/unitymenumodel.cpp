@@ -17,17 +17,26 @@
  */
 
 #include "unitymenumodel.h"
+#include "accelparser.h"
 #include "converter.h"
+#include "stringcache.h"
+#include "iconcache.h"
 #include "actionstateparser.h"
 #include "unitymenumodelevents.h"
 #include "unitymenuaction.h"
 #include "unitymenuactionevents.h"
 #include "logging.h"
 
-#include <QIcon>
 #include <QQmlComponent>
+#include <QQmlEngine>
 #include <QCoreApplication>
+#include <QHash>
 #include <QKeySequence>
+#include <QPointer>
+#include <QSet>
+#include <QSharedPointer>
+
+#include <algorithm>
 
 extern "C" {
   #include "gtk/gtkactionmuxer.h"
@@ -41,6 +50,7 @@ G_DEFINE_QUARK (UNITY_MENU_MODEL, unity_menu_model)
 G_DEFINE_QUARK (UNITY_SUBMENU_MODEL, unity_submenu_model)
 G_DEFINE_QUARK (UNITY_MENU_ITEM_EXTENDED_ATTRIBUTES, unity_menu_item_extended_attributes)
 G_DEFINE_QUARK (UNITY_MENU_ACTION, unity_menu_action)
+G_DEFINE_QUARK (UNITY_MENU_ITEM_ROW, unity_menu_item_row)
 
 
 enum MenuRoles {
@@ -56,8 +66,31 @@ enum MenuRoles {
     IsRadioRole,
     IsToggledRole,
     ShortcutRole,
-    HasSubmenuRole
+    HasSubmenuRole,
+    IsVisibleRole
+};
+
+/* Bit of @role in the role masks queued by menuItemChanged() */
+static inline quint32 roleBit(int role)
+{
+    return 1u << (role - LabelRole);
+}
+
+static const quint32 AllRoles = ~0u;
+
+/* One row of the model: the tracker item and the values data() last
+ * decoded from it. @cached holds the roleBit()s of the values that are
+ * valid, menuItemChanged() clears them again; @flags holds the roleBit()s
+ * of the boolean roles that are true. */
+struct UnityMenuModelRow
+{
+    GtkMenuTrackerItem *item;
+    quint32 cached;
+    quint32 flags;
+    QString label;
+    QString action;
 };
+Q_DECLARE_TYPEINFO(UnityMenuModelRow, Q_MOVABLE_TYPE);
 
 class UnityMenuModelPrivate
 {
@@ -69,28 +102,41 @@ public:
     void clearItems(bool resetModel=true);
     void clearName();
     void updateActions();
+    void clearActionGroups();
     void updateMenuModel();
     QVariant itemState(GtkMenuTrackerItem *item);
+    void registerImageProvider();
+    GtkMenuTrackerItem *itemAt(int position) const;
+    int rowOf(GtkMenuTrackerItem *item) const;
+    void renumberRows(int from);
 
     UnityMenuModel *model;
     GtkActionMuxer *muxer;
     GtkMenuTracker *menutracker;
-    GSequence *items;
+    QVector<UnityMenuModelRow> items;
     GDBusConnection *connection;
     QByteArray busName;
     QByteArray nameOwner;
     guint nameWatchId;
     QVariantMap actions;
+    QHash<QString, QByteArray> boundActions;
+    QHash<QByteArray, GDBusActionGroup*> actionGroups;
     QByteArray menuObjectPath;
     QHash<QByteArray, int> roles;
     ActionStateParser* actionStateParser;
     QHash<UnityMenuAction*, GtkSimpleActionObserver*> registeredActions;
     bool destructorGuard;
+    bool imageProviderRegistered;
+    QHash<GtkMenuTrackerItem*, quint32> pendingChanges;
+    bool dataChangePosted;
+
+    void queueDataChange(GtkMenuTrackerItem *item, quint32 roles);
+    void flushDataChanges();
 
     static void nameAppeared(GDBusConnection *connection, const gchar *name, const gchar *owner, gpointer user_data);
     static void nameVanished(GDBusConnection *connection, const gchar *name, gpointer user_data);
-    static void menuItemInserted(GtkMenuTrackerItem *item, gint position, gpointer user_data);
-    static void menuItemRemoved(gint position, gpointer user_data);
+    static void menuItemInserted(GtkMenuTrackerItem **items, gint position, gint n_items, gpointer user_data);
+    static void menuItemRemoved(gint position, gint n_items, gpointer user_data);
     static void menuItemChanged(GObject *object, GParamSpec *pspec, gpointer user_data);
 
     static void registeredActionAdded(GtkSimpleActionObserver    *observer_item,
@@ -110,9 +156,32 @@ void menu_item_free (gpointer data)
     GtkMenuTrackerItem *item = (GtkMenuTrackerItem *) data;
 
     g_signal_handlers_disconnect_by_func (item, (gpointer) UnityMenuModelPrivate::menuItemChanged, NULL);
+    /* the submenu model goes away together with its row */
+    g_object_set_qdata (G_OBJECT (item), unity_submenu_model_quark (), NULL);
+    g_object_set_qdata (G_OBJECT (item), unity_menu_item_row_quark (), NULL);
     g_object_unref (item);
 }
 
+/* What the UNITY_SUBMENU_MODEL qdata of an item holds: the shared
+ * submenu model and the component its action state parser came from */
+struct UnitySubmenu
+{
+    QPointer<UnityMenuModel> model;
+    QPointer<QQmlComponent> parserComponent;
+};
+
+/* Destroy notify for the submenu model attached to an item. The pointer
+ * is guarded, so a model deleted from elsewhere (e.g. together with its
+ * parent) is not deleted twice and gets rebuilt on the next submenu() */
+static void submenu_model_free (gpointer data)
+{
+    UnitySubmenu *submenu = (UnitySubmenu *) data;
+
+    if (!submenu->model.isNull())
+        submenu->model->deleteLater();
+    delete submenu;
+}
+
 UnityMenuModelPrivate::UnityMenuModelPrivate(UnityMenuModel *model)
 {
     this->model = model;
@@ -121,10 +190,10 @@ UnityMenuModelPrivate::UnityMenuModelPrivate(UnityMenuModel *model)
     this->nameWatchId = 0;
     this->actionStateParser = new ActionStateParser(model);
     this->destructorGuard = false;
+    this->imageProviderRegistered = false;
+    this->dataChangePosted = false;
 
     this->muxer = gtk_action_muxer_new ();
-
-    this->items = g_sequence_new (menu_item_free);
 }
 
 UnityMenuModelPrivate::UnityMenuModelPrivate(const UnityMenuModelPrivate& other, UnityMenuModel *model)
@@ -135,10 +204,10 @@ UnityMenuModelPrivate::UnityMenuModelPrivate(const UnityMenuModelPrivate& other,
     this->nameWatchId = 0;
     this->actionStateParser = new ActionStateParser(model);
     this->destructorGuard = false;
+    this->imageProviderRegistered = false;
+    this->dataChangePosted = false;
 
     this->muxer = GTK_ACTION_MUXER( g_object_ref(other.muxer));
-
-    this->items = g_sequence_new (menu_item_free);
 }
 
 UnityMenuModelPrivate::~UnityMenuModelPrivate()
@@ -146,9 +215,9 @@ UnityMenuModelPrivate::~UnityMenuModelPrivate()
     this->destructorGuard = true;
     this->clearItems(false);
 
-    g_sequence_free(this->items);
     g_clear_pointer (&this->menutracker, gtk_menu_tracker_free);
     g_clear_object (&this->muxer);
+    this->clearActionGroups();
     g_clear_object (&this->connection);
 
     QHash<UnityMenuAction*, GtkSimpleActionObserver*>::const_iterator it = this->registeredActions.constBegin();
@@ -168,6 +237,34 @@ void UnityMenuModelPrivate::clearItems(bool resetModel)
     QCoreApplication::sendEvent(model, &ummce);
 }
 
+/* Returns the tracker item of row @position, NULL if out of range */
+GtkMenuTrackerItem *UnityMenuModelPrivate::itemAt(int position) const
+{
+    if (position < 0 || position >= this->items.size())
+        return NULL;
+
+    return this->items.at(position).item;
+}
+
+/* Returns the row of @item, -1 if it is not in this model */
+int UnityMenuModelPrivate::rowOf(GtkMenuTrackerItem *item) const
+{
+    int row = GPOINTER_TO_INT (g_object_get_qdata (G_OBJECT (item), unity_menu_item_row_quark ())) - 1;
+
+    if (row >= 0 && row < this->items.size() && this->items.at(row).item == item)
+        return row;
+    return -1;
+}
+
+/* Stores on each item from row @from on the row it now has, after rows
+ * were inserted or removed in front of it. The row is kept off by one so
+ * that an item without one reads as -1 */
+void UnityMenuModelPrivate::renumberRows(int from)
+{
+    for (int i = from; i < this->items.size(); i++)
+        g_object_set_qdata (G_OBJECT (this->items.at(i).item), unity_menu_item_row_quark (), GINT_TO_POINTER (i + 1));
+}
+
 void UnityMenuModelPrivate::clearName()
 {
     this->clearItems();
@@ -180,24 +277,68 @@ void UnityMenuModelPrivate::clearName()
     Q_EMIT model->nameOwnerChanged (this->nameOwner);
 }
 
+/* Brings the muxer in line with the prefix -> object path map in
+ * this->actions. Only prefixes that were added, removed or moved to
+ * another path are touched, so observers of the other groups see no
+ * remove/add cycle.
+ *
+ * The GDBusActionGroups are shared per path by the prefixes bound to
+ * it. They talk to the current name owner, so they are all dropped when
+ * the name loses its owner. */
 void UnityMenuModelPrivate::updateActions()
 {
-    Q_FOREACH (QString prefix, this->actions.keys())
-        gtk_action_muxer_remove (this->muxer, prefix.toUtf8());
+    QHash<QString, QByteArray> wanted;
+
+    if (!this->nameOwner.isEmpty()) {
+        for (QVariantMap::const_iterator it = this->actions.constBegin(); it != this->actions.constEnd(); ++it)
+            wanted.insert(it.key(), it.value().toByteArray());
+    }
 
-    if (this->nameOwner.isEmpty())
-      return;
+    QHash<QString, QByteArray>::iterator bound = this->boundActions.begin();
+    while (bound != this->boundActions.end()) {
+        QHash<QString, QByteArray>::const_iterator match = wanted.constFind(bound.key());
+        if (match != wanted.constEnd() && match.value() == bound.value()) {
+            ++bound;
+        } else {
+            gtk_action_muxer_remove (this->muxer, bound.key().toUtf8());
+            bound = this->boundActions.erase(bound);
+        }
+    }
 
-    for (QVariantMap::const_iterator it = this->actions.constBegin(); it != this->actions.constEnd(); ++it) {
-        GDBusActionGroup *actions;
+    for (QHash<QString, QByteArray>::const_iterator it = wanted.constBegin(); it != wanted.constEnd(); ++it) {
+        if (this->boundActions.contains(it.key()))
+            continue;
+
+        GDBusActionGroup *actions = this->actionGroups.value(it.value());
+        if (actions == NULL) {
+            actions = g_dbus_action_group_get (this->connection, this->nameOwner, it.value());
+            this->actionGroups.insert(it.value(), actions);
+        }
 
-        actions = g_dbus_action_group_get (this->connection, this->nameOwner, it.value().toByteArray());
         gtk_action_muxer_insert (this->muxer, it.key().toUtf8(), G_ACTION_GROUP (actions));
+        this->boundActions.insert(it.key(), it.value());
+    }
 
-        g_object_unref (actions);
+    /* groups no prefix refers to any more */
+    const QSet<QByteArray> wantedPaths = wanted.values().toSet();
+    QHash<QByteArray, GDBusActionGroup*>::iterator group = this->actionGroups.begin();
+    while (group != this->actionGroups.end()) {
+        if (!wantedPaths.contains(group.key())) {
+            g_object_unref (group.value());
+            group = this->actionGroups.erase(group);
+        } else {
+            ++group;
+        }
     }
 }
 
+void UnityMenuModelPrivate::clearActionGroups()
+{
+    Q_FOREACH (GDBusActionGroup *actions, this->actionGroups)
+        g_object_unref (actions);
+    this->actionGroups.clear();
+}
+
 void UnityMenuModelPrivate::updateMenuModel()
 {
     this->clearItems();
@@ -230,6 +371,24 @@ QVariant UnityMenuModelPrivate::itemState(GtkMenuTrackerItem *item)
     return result;
 }
 
+/* Makes sure the engine showing this model (or the model it is a submenu
+ * of) can load the image:// URIs IconCache hands out for bytes icons */
+void UnityMenuModelPrivate::registerImageProvider()
+{
+    QQmlEngine *engine = NULL;
+
+    if (this->imageProviderRegistered)
+        return;
+
+    for (QObject *object = this->model; object && !engine; object = object->parent())
+        engine = qmlEngine(object);
+
+    if (engine) {
+        IconCache::registerImageProvider(engine);
+        this->imageProviderRegistered = true;
+    }
+}
+
 void UnityMenuModelPrivate::nameAppeared(GDBusConnection *connection, const gchar *name, const gchar *owner, gpointer user_data)
 {
     UnityMenuModelPrivate *priv = (UnityMenuModelPrivate *)user_data;
@@ -250,37 +409,132 @@ void UnityMenuModelPrivate::nameVanished(GDBusConnection *connection, const gcha
     priv->clearName();
 }
 
-void UnityMenuModelPrivate::menuItemInserted(GtkMenuTrackerItem *item, gint position, gpointer user_data)
+void UnityMenuModelPrivate::menuItemInserted(GtkMenuTrackerItem **items, gint position, gint n_items, gpointer user_data)
 {
     UnityMenuModelPrivate *priv = (UnityMenuModelPrivate *)user_data;
 
-    UnityMenuModelAddRowEvent ummare(item, position);
+    UnityMenuModelAddRowEvent ummare(items, position, n_items);
     QCoreApplication::sendEvent(priv->model, &ummare);
 }
 
-void UnityMenuModelPrivate::menuItemRemoved(gint position, gpointer user_data)
+void UnityMenuModelPrivate::menuItemRemoved(gint position, gint n_items, gpointer user_data)
 {
     UnityMenuModelPrivate *priv = (UnityMenuModelPrivate *)user_data;
 
-    UnityMenuModelRemoveRowEvent ummrre(position);
+    UnityMenuModelRemoveRowEvent ummrre(position, n_items);
     QCoreApplication::sendEvent(priv->model, &ummrre);
 }
 
+/* Returns the roles affected by a change of the GtkMenuTrackerItem
+ * property @pspec, AllRoles for unknown ones */
+static quint32 rolesForProperty(GParamSpec *pspec)
+{
+    static const struct {
+        const char *name;
+        quint32 roles;
+    } properties[] = {
+        { "label",          roleBit(LabelRole) },
+        { "sensitive",      roleBit(SensitiveRole) },
+        { "is-separator",   roleBit(IsSeparatorRole) },
+        { "icon",           roleBit(IconRole) },
+        { "action-name",    roleBit(ActionRole) },
+        { "action-state",   roleBit(ActionStateRole) },
+        { "role",           roleBit(IsCheckRole) | roleBit(IsRadioRole) },
+        { "toggled",        roleBit(IsToggledRole) },
+        { "accel",          roleBit(ShortcutRole) },
+        { "has-submenu",    roleBit(HasSubmenuRole) },
+        { "visible",        roleBit(IsVisibleRole) },
+        // not exposed as a role
+        { "submenu-shown",  0 }
+    };
+
+    for (uint i = 0; i < G_N_ELEMENTS (properties); i++) {
+        if (strcmp (pspec->name, properties[i].name) == 0)
+            return properties[i].roles;
+    }
+    return AllRoles;
+}
+
+static QVector<int> rolesFromMask(quint32 mask)
+{
+    QVector<int> roles;
+
+    if (mask == AllRoles)
+        return roles;
+
+    for (int role = LabelRole; role <= IsVisibleRole; role++) {
+        if (mask & roleBit(role))
+            roles << role;
+    }
+    return roles;
+}
+
 void UnityMenuModelPrivate::menuItemChanged(GObject *object, GParamSpec *pspec, gpointer user_data)
 {
-    GSequenceIter *it = (GSequenceIter *) user_data;
-    GtkMenuTrackerItem *item;
-    GtkActionObservable *muxer;
+    GtkMenuTrackerItem *item = (GtkMenuTrackerItem *) object;
     UnityMenuModel *model;
-    gint position;
+    quint32 roles;
+    int row;
+
+    roles = rolesForProperty (pspec);
+    if (roles == 0)
+        return;
 
-    item = (GtkMenuTrackerItem *) g_sequence_get (it);
-    muxer = _gtk_menu_tracker_item_get_observable (item);
     model = (UnityMenuModel *) g_object_get_qdata (G_OBJECT (item), unity_menu_model_quark ());
-    position = g_sequence_iter_get_position (it);
 
-    UnityMenuModelDataChangeEvent ummdce(position);
-    QCoreApplication::sendEvent(model, &ummdce);
+    /* reads between now and the flush must not see the old values */
+    row = model->priv->rowOf (item);
+    if (row >= 0)
+        model->priv->items[row].cached &= ~roles;
+
+    model->priv->queueDataChange (item, roles);
+}
+
+/* Records that @roles of the row of @item changed. The changes are emitted
+ * together once control returns to the event loop, so a burst of
+ * notifications (e.g. a radio group toggling) becomes a few ranged
+ * dataChanged() signals */
+void UnityMenuModelPrivate::queueDataChange(GtkMenuTrackerItem *item, quint32 roles)
+{
+    this->pendingChanges[item] |= roles;
+
+    if (!this->dataChangePosted) {
+        this->dataChangePosted = true;
+        QCoreApplication::postEvent(this->model, new UnityMenuModelDataChangeEvent);
+    }
+}
+
+/* Emits the queued changes, merging adjacent rows with the same roles */
+void UnityMenuModelPrivate::flushDataChanges()
+{
+    QVector<QPair<int, quint32> > changes;
+
+    this->dataChangePosted = false;
+    if (this->pendingChanges.isEmpty())
+        return;
+
+    /* rows may have moved since, find where the items are now */
+    changes.reserve(this->pendingChanges.size());
+    for (QHash<GtkMenuTrackerItem*, quint32>::const_iterator it = this->pendingChanges.constBegin(); it != this->pendingChanges.constEnd(); ++it) {
+        int row = this->rowOf(it.key());
+        if (row >= 0)
+            changes << qMakePair(row, it.value());
+    }
+    this->pendingChanges.clear();
+    std::sort(changes.begin(), changes.end());
+
+    for (int i = 0; i < changes.size(); i++) {
+        int top = changes[i].first;
+        int bottom = top;
+        quint32 roles = changes[i].second;
+
+        while (i + 1 < changes.size() && changes[i + 1].first == bottom + 1 && changes[i + 1].second == roles) {
+            bottom++;
+            i++;
+        }
+
+        Q_EMIT model->dataChanged(model->index(top, 0), model->index(bottom, 0), rolesFromMask(roles));
+    }
 }
 
 UnityMenuModel::UnityMenuModel(QObject *parent):
@@ -364,7 +618,7 @@ void UnityMenuModel::setActionStateParser(ActionStateParser* actionStateParser)
 
 int UnityMenuModel::rowCount(const QModelIndex &parent) const
 {
-    return !parent.isValid() ? g_sequence_get_length (priv->items) : 0;
+    return !parent.isValid() ? priv->items.size() : 0;
 }
 
 int UnityMenuModel::columnCount(const QModelIndex &parent) const
@@ -372,80 +626,82 @@ int UnityMenuModel::columnCount(const QModelIndex &parent) const
     return 1;
 }
 
-static QString iconUri(GIcon *icon)
+/* Returns the boolean @role of @row, only asking the tracker item when
+ * the value is not cached */
+static bool rowFlag(UnityMenuModelRow &row, int role)
 {
-    QString uri;
-
-    if (G_IS_THEMED_ICON (icon)) {
-        const gchar* const* iconNames = g_themed_icon_get_names (G_THEMED_ICON (icon));
-        guint index = 0;
-        while(iconNames[index] != NULL) {
-            if (QIcon::hasThemeIcon(iconNames[index])) {
-                uri = QString("image://theme/") + iconNames[index];
-                break;
-            }
-            index++;
-        }
-    }
-    else if (G_IS_FILE_ICON (icon)) {
-        GFile *file;
+    const quint32 bit = roleBit(role);
 
-        file = g_file_icon_get_file (G_FILE_ICON (icon));
-        if (file) {
-            gchar *fileuri;
+    if (!(row.cached & bit)) {
+        bool value = false;
 
-            fileuri = g_file_get_uri (file);
-            uri = QString(fileuri);
-
-            g_free (fileuri);
+        switch (role) {
+            case SensitiveRole:
+                value = gtk_menu_tracker_item_get_sensitive (row.item) != FALSE;
+                break;
+            case IsSeparatorRole:
+                value = gtk_menu_tracker_item_get_is_separator (row.item) != FALSE;
+                break;
+            case IsCheckRole:
+                value = gtk_menu_tracker_item_get_role (row.item) == GTK_MENU_TRACKER_ITEM_ROLE_CHECK;
+                break;
+            case IsRadioRole:
+                value = gtk_menu_tracker_item_get_role (row.item) == GTK_MENU_TRACKER_ITEM_ROLE_RADIO;
+                break;
+            case IsToggledRole:
+                value = gtk_menu_tracker_item_get_toggled (row.item) != FALSE;
+                break;
+            case HasSubmenuRole:
+                value = gtk_menu_tracker_item_get_has_submenu (row.item) != FALSE;
+                break;
+            case IsVisibleRole:
+                value = gtk_menu_tracker_item_get_visible (row.item) != FALSE;
+                break;
         }
-    }
-    else if (G_IS_BYTES_ICON (icon)) {
-        gsize size;
-        gconstpointer data;
-        gchar *base64;
 
-        data = g_bytes_get_data (g_bytes_icon_get_bytes (G_BYTES_ICON (icon)), &size);
-        base64 = g_base64_encode ((const guchar *) data, size);
-
-        uri = QString("data://");
-        uri.append (base64);
-
-        g_free (base64);
+        row.flags = value ? (row.flags | bit) : (row.flags & ~bit);
+        row.cached |= bit;
     }
 
-    return uri;
+    return row.flags & bit;
 }
 
 QVariant UnityMenuModel::data(const QModelIndex &index, int role) const
 {
-    GSequenceIter *it;
     GtkMenuTrackerItem *item;
 
-    it = g_sequence_get_iter_at_pos (priv->items, index.row());
-    if (g_sequence_iter_is_end (it)) {
+    if (index.row() < 0 || index.row() >= priv->items.size()) {
         return QVariant();
     }
 
-    item = (GtkMenuTrackerItem *) g_sequence_get (it);
+    UnityMenuModelRow &row = priv->items[index.row()];
+    item = row.item;
     if (!item) {
         return QVariant();
     }
 
     switch (role) {
         case LabelRole:
-            return gtk_menu_tracker_item_get_label (item);
+            if (!(row.cached & roleBit(LabelRole))) {
+                row.label = QString::fromUtf8(gtk_menu_tracker_item_get_label (item));
+                row.cached |= roleBit(LabelRole);
+            }
+            return row.label;
 
         case SensitiveRole:
-            return gtk_menu_tracker_item_get_sensitive (item) == TRUE ? true : false;
-
         case IsSeparatorRole:
-            return gtk_menu_tracker_item_get_is_separator (item) == TRUE ? true : false;
+        case IsCheckRole:
+        case IsRadioRole:
+        case IsToggledRole:
+        case HasSubmenuRole:
+        case IsVisibleRole:
+            return rowFlag(row, role);
 
         case IconRole: {
             GIcon *icon = gtk_menu_tracker_item_get_icon (item);
             if (icon) {
-                QString uri = iconUri(icon);
+                priv->registerImageProvider();
+                QString uri = IconCache::uri(icon);
                 g_object_unref (icon);
                 return uri;
             }
@@ -454,10 +710,10 @@ QVariant UnityMenuModel::data(const QModelIndex &index, int role) const
         }
 
         case TypeRole: {
-            gchar *type;
-            if (gtk_menu_tracker_item_get_attribute (item, "x-canonical-type", "s", &type)) {
-                QVariant v(type);
-                g_free (type);
+            GVariant *type = gtk_menu_tracker_item_get_attribute_value (item, "x-canonical-type", G_VARIANT_TYPE_STRING);
+            if (type) {
+                QVariant v(StringCache::intern(g_variant_get_string (type, NULL)));
+                g_variant_unref (type);
                 return v;
             }
             else
@@ -469,30 +725,20 @@ QVariant UnityMenuModel::data(const QModelIndex &index, int role) const
             return map ? *map : QVariant();
         }
 
-        case ActionRole: {
-            gchar *action_name = gtk_menu_tracker_item_get_action_name (item);
-            QString v(action_name);
-            g_free(action_name);
-            return v;
-        }
+        case ActionRole:
+            if (!(row.cached & roleBit(ActionRole))) {
+                gchar *action_name = gtk_menu_tracker_item_get_action_name (item);
+                row.action = StringCache::intern(action_name);
+                row.cached |= roleBit(ActionRole);
+                g_free(action_name);
+            }
+            return row.action;
 
         case ActionStateRole:
             return priv->itemState(item);
 
-        case IsCheckRole:
-            return gtk_menu_tracker_item_get_role (item) == GTK_MENU_TRACKER_ITEM_ROLE_CHECK;
-
-        case IsRadioRole:
-            return gtk_menu_tracker_item_get_role (item) == GTK_MENU_TRACKER_ITEM_ROLE_RADIO;
-
-        case IsToggledRole:
-            return gtk_menu_tracker_item_get_toggled (item) != FALSE;
-
         case ShortcutRole:
-            return QKeySequence(gtk_menu_tracker_item_get_accel (item), QKeySequence::NativeText);
-
-        case HasSubmenuRole:
-            return gtk_menu_tracker_item_get_has_submenu (item) != FALSE;
+            return AccelParser::toKeySequence(gtk_menu_tracker_item_get_accel (item));
 
         default:
             return QVariant();
@@ -526,42 +772,62 @@ QHash<int, QByteArray> UnityMenuModel::roleNames() const
     names[IsToggledRole] = "isToggled";
     names[ShortcutRole] = "shortcut";
     names[HasSubmenuRole] = "hasSubmenu";
+    names[IsVisibleRole] = "isVisible";
 
     return names;
 }
 
+/* One model per item, shared by every caller; QML re-evaluating a binding
+ * must not build a new tracker each time. The model keeps the parser of
+ * the last non-null @actionStateParser component it was asked for: a call
+ * with a different component swaps the parser (and refreshes actionState),
+ * a call without one leaves it alone */
 QObject * UnityMenuModel::submenu(int position, QQmlComponent* actionStateParser)
 {
-    GSequenceIter *it;
     GtkMenuTrackerItem *item;
+    UnitySubmenu *submenu;
     UnityMenuModel *model;
+    bool created = false;
 
-    it = g_sequence_get_iter_at_pos (priv->items, position);
-    if (g_sequence_iter_is_end (it)) {
-        return NULL;
-    }
-
-    item = (GtkMenuTrackerItem *) g_sequence_get (it);
+    item = priv->itemAt(position);
     if (!item || !gtk_menu_tracker_item_get_has_submenu (item)) {
         return NULL;
     }
 
-    model = (UnityMenuModel *) g_object_get_qdata (G_OBJECT (item), unity_submenu_model_quark ());
-    if (model == NULL) {
+    submenu = (UnitySubmenu *) g_object_get_qdata (G_OBJECT (item), unity_submenu_model_quark ());
+    if (submenu && !submenu->model.isNull()) {
+        model = submenu->model.data();
+    } else {
         model = new UnityMenuModel(*priv, this);
+        submenu = new UnitySubmenu;
+        submenu->model = model;
+        created = true;
+    }
 
-        if (actionStateParser) {
-            ActionStateParser* parser = qobject_cast<ActionStateParser*>(actionStateParser->create());
-            if (parser) {
-                model->setActionStateParser(parser);
-            }
+    if (actionStateParser && actionStateParser != submenu->parserComponent) {
+        ActionStateParser* parser = qobject_cast<ActionStateParser*>(actionStateParser->create());
+        if (parser) {
+            ActionStateParser* previous = model->actionStateParser();
+
+            parser->setParent(model);
+            model->setActionStateParser(parser);
+            submenu->parserComponent = actionStateParser;
+
+            /* parsers made here or by the model itself are owned by it */
+            if (previous && previous->parent() == model)
+                previous->deleteLater();
+            for (int i = 0; i < model->priv->items.size(); i++)
+                model->priv->queueDataChange (model->priv->items.at(i).item, roleBit(ActionStateRole));
         }
+    }
 
+    if (created) {
         model->priv->menutracker = gtk_menu_tracker_new_for_item_submenu (item,
                                                                           UnityMenuModelPrivate::menuItemInserted,
                                                                           UnityMenuModelPrivate::menuItemRemoved,
                                                                           model->priv);
-        g_object_set_qdata (G_OBJECT (item), unity_submenu_model_quark (), model);
+        g_object_set_qdata_full (G_OBJECT (item), unity_submenu_model_quark (),
+                                 submenu, submenu_model_free);
     }
 
     return model;
@@ -573,54 +839,6 @@ static void freeExtendedAttrs(gpointer data)
     delete extendedAttrs;
 }
 
-static QVariant attributeToQVariant(GVariant *value, const QString &type)
-{
-    QVariant result;
-
-    if (type == "int") {
-        if (g_variant_is_of_type (value, G_VARIANT_TYPE_INT32)) {
-            result =  QVariant(g_variant_get_int32(value));
-        }
-    }
-    else if (type == "int64") {
-        if (g_variant_is_of_type (value, G_VARIANT_TYPE_INT64)) {
-            result =  QVariant((qlonglong)g_variant_get_int64(value));
-        }
-    }
-    else if (type == "bool") {
-        if (g_variant_is_of_type (value, G_VARIANT_TYPE_BOOLEAN)) {
-            result = QVariant(g_variant_get_boolean(value));
-        }
-    }
-    else if (type == "string") {
-        if (g_variant_is_of_type (value, G_VARIANT_TYPE_STRING)) {
-            result = QVariant(g_variant_get_string(value, NULL));
-        }
-    }
-    else if (type == "double") {
-        if (g_variant_is_of_type (value, G_VARIANT_TYPE_DOUBLE)) {
-            result = QVariant(g_variant_get_double(value));
-        }
-    }
-    else if (type == "variant") {
-        if (g_variant_is_of_type (value, G_VARIANT_TYPE_VARIANT)) {
-            result = Converter::toQVariant(value);
-        }
-    }
-    else if (type == "icon") {
-        GIcon *icon = g_icon_deserialize (value);
-        if (icon) {
-            result = iconUri(icon);
-            g_object_unref (icon);
-        }
-        else {
-            result = QVariant("");
-        }
-    }
-
-    return result;
-}
-
 /* convert 'some-key' to 'someKey' or 'SomeKey'. (from dconf-qt) */
 static QString qtify_name(const char *name)
 {
@@ -643,40 +861,196 @@ static QString qtify_name(const char *name)
     return result;
 }
 
+/* A loadExtendedAttributes() schema, with every attribute resolved once:
+ * its name interned as a GQuark string, the GVariant type it must have
+ * and the key it gets in the extended attributes map */
+class ExtendedAttributeSchema
+{
+public:
+    enum Kind {
+        Unknown,
+        Int,
+        Int64,
+        Bool,
+        String,
+        Double,
+        Variant,
+        Icon
+    };
+
+    struct Attribute {
+        const gchar *name;
+        QByteArray typeName;
+        Kind kind;
+        const GVariantType *expected;
+        QString key;
+    };
+
+    explicit ExtendedAttributeSchema(const QVariantMap &schema);
+
+    QVector<Attribute> attributes;
+};
+
+ExtendedAttributeSchema::ExtendedAttributeSchema(const QVariantMap &schema)
+{
+    static const struct {
+        const char *name;
+        Kind kind;
+        const GVariantType *expected;
+    } kinds[] = {
+        { "int",     Int,     G_VARIANT_TYPE_INT32 },
+        { "int64",   Int64,   G_VARIANT_TYPE_INT64 },
+        { "bool",    Bool,    G_VARIANT_TYPE_BOOLEAN },
+        { "string",  String,  G_VARIANT_TYPE_STRING },
+        { "double",  Double,  G_VARIANT_TYPE_DOUBLE },
+        { "variant", Variant, G_VARIANT_TYPE_VARIANT },
+        // any serialized GIcon
+        { "icon",    Icon,    NULL }
+    };
+
+    attributes.reserve(schema.size());
+    for (QVariantMap::const_iterator it = schema.constBegin(); it != schema.constEnd(); ++it) {
+        Attribute attribute;
+        QByteArray name = it.key().toUtf8();
+
+        attribute.name = g_quark_to_string (g_quark_from_string (name.constData()));
+        attribute.typeName = it.value().toString().toUtf8();
+        attribute.kind = Unknown;
+        attribute.expected = NULL;
+        attribute.key = qtify_name (attribute.name);
+
+        for (uint i = 0; i < G_N_ELEMENTS (kinds); i++) {
+            if (attribute.typeName == kinds[i].name) {
+                attribute.kind = kinds[i].kind;
+                attribute.expected = kinds[i].expected;
+                break;
+            }
+        }
+        attributes << attribute;
+    }
+}
+
+/* Compiled schemas of the last few distinct schema maps. QML builds a
+ * new map for every call, so entries are matched on a hash of the keys
+ * and type names taken once per lookup, and the contents are compared
+ * only when the hash matches */
+class ExtendedAttributeSchemaCache
+{
+public:
+    enum { MaxEntries = 16 };
+
+    QSharedPointer<const ExtendedAttributeSchema> lookup(const QVariantMap &schema)
+    {
+        uint hash = hashSchema(schema);
+
+        for (int i = 0; i < entries.size(); i++) {
+            const Entry &entry = entries.at(i);
+            if (entry.hash == hash && entry.schema == schema) {
+                if (i > 0)
+                    entries.move(i, 0);
+                return entries.first().compiled;
+            }
+        }
+
+        Entry entry;
+        entry.hash = hash;
+        entry.schema = schema;
+        entry.compiled = QSharedPointer<const ExtendedAttributeSchema>(new ExtendedAttributeSchema(schema));
+        entries.prepend(entry);
+        if (entries.size() > MaxEntries)
+            entries.removeLast();
+        return entry.compiled;
+    }
+
+private:
+    struct Entry {
+        uint hash;
+        QVariantMap schema;
+        QSharedPointer<const ExtendedAttributeSchema> compiled;
+    };
+
+    static uint hashSchema(const QVariantMap &schema)
+    {
+        uint hash = 0;
+        for (QVariantMap::const_iterator it = schema.constBegin(); it != schema.constEnd(); ++it) {
+            hash = 31 * hash + qHash(it.key());
+            hash = 31 * hash + qHash(it.value().toString());
+        }
+        return hash;
+    }
+
+    QList<Entry> entries;
+};
+
+Q_GLOBAL_STATIC(ExtendedAttributeSchemaCache, extendedAttributeSchemas)
+
+static QVariant attributeToQVariant(GVariant *value, const ExtendedAttributeSchema::Attribute &attribute)
+{
+    if (attribute.expected && !g_variant_is_of_type (value, attribute.expected))
+        return QVariant();
+
+    switch (attribute.kind) {
+        case ExtendedAttributeSchema::Int:
+            return QVariant(g_variant_get_int32(value));
+
+        case ExtendedAttributeSchema::Int64:
+            return QVariant((qlonglong)g_variant_get_int64(value));
+
+        case ExtendedAttributeSchema::Bool:
+            return QVariant(g_variant_get_boolean(value));
+
+        case ExtendedAttributeSchema::String:
+            return QVariant(g_variant_get_string(value, NULL));
+
+        case ExtendedAttributeSchema::Double:
+            return QVariant(g_variant_get_double(value));
+
+        case ExtendedAttributeSchema::Variant:
+            return Converter::toQVariant(value);
+
+        case ExtendedAttributeSchema::Icon: {
+            QVariant result("");
+            GIcon *icon = g_icon_deserialize (value);
+            if (icon) {
+                result = IconCache::uri(icon);
+                g_object_unref (icon);
+            }
+            return result;
+        }
+
+        default:
+            return QVariant();
+    }
+}
+
 bool UnityMenuModel::loadExtendedAttributes(int position, const QVariantMap &schema)
 {
-    GSequenceIter *it;
     GtkMenuTrackerItem *item;
+    QSharedPointer<const ExtendedAttributeSchema> compiled;
     QVariantMap *extendedAttrs;
 
-    it = g_sequence_get_iter_at_pos (priv->items, position);
-    if (g_sequence_iter_is_end (it)) {
-        return false;
-    }
-
-    item = (GtkMenuTrackerItem *) g_sequence_get (it);
+    item = priv->itemAt(position);
     if (!item) {
         return false;
     }
 
+    priv->registerImageProvider();
+    compiled = extendedAttributeSchemas()->lookup(schema);
     extendedAttrs = new QVariantMap;
 
-    for (QVariantMap::const_iterator it = schema.constBegin(); it != schema.constEnd(); ++it) {
-        QString name = it.key();
-        QString type = it.value().toString();
-
-        GVariant *value = gtk_menu_tracker_item_get_attribute_value (item, name.toUtf8(), NULL);
+    Q_FOREACH (const ExtendedAttributeSchema::Attribute &attribute, compiled->attributes) {
+        GVariant *value = gtk_menu_tracker_item_get_attribute_value (item, attribute.name, NULL);
         if (value == NULL) {
-            qCWarning(unitymenumodel, "loadExtendedAttributes: menu item does not contain '%s'", it.key().toUtf8().constData());
+            qCWarning(unitymenumodel, "loadExtendedAttributes: menu item does not contain '%s'", attribute.name);
             continue;
         }
 
-        const QVariant &qvalue = attributeToQVariant(value, type);
+        const QVariant &qvalue = attributeToQVariant(value, attribute);
         if (qvalue.isValid())
-            extendedAttrs->insert(qtify_name (name.toUtf8()), qvalue);
+            extendedAttrs->insert(attribute.key, qvalue);
         else
             qCWarning(unitymenumodel, "loadExtendedAttributes: key '%s' is of type '%s' (expected '%s')",
-                     name.toUtf8().constData(), g_variant_get_type_string(value), type.constData());
+                     attribute.name, g_variant_get_type_string(value), attribute.typeName.constData());
 
         g_variant_unref (value);
     }
@@ -701,17 +1075,11 @@ QVariant UnityMenuModel::get(int row, const QByteArray &role)
 
 void UnityMenuModel::activate(int index, const QVariant& parameter)
 {
-    GSequenceIter *it;
     GtkMenuTrackerItem *item;
     GVariant *value;
     const GVariantType *parameter_type;
 
-    it = g_sequence_get_iter_at_pos (priv->items, index);
-    if (g_sequence_iter_is_end (it)) {
-        return;
-    }
-
-    item = (GtkMenuTrackerItem *) g_sequence_get (it);
+    item = priv->itemAt(index);
     if (!item) {
         return;
     }
@@ -742,17 +1110,11 @@ void UnityMenuModel::changeStateByVariantString(int index, const QString& parame
 
 void UnityMenuModel::changeState(int index, const QVariant& parameter)
 {
-    GSequenceIter *it;
     GtkMenuTrackerItem* item;
     GVariant* data;
     GVariant* current_state;
 
-    it = g_sequence_get_iter_at_pos (priv->items, index);
-    if (g_sequence_iter_is_end (it)) {
-        return;
-    }
-
-    item = (GtkMenuTrackerItem *) g_sequence_get (it);
+    item = priv->itemAt(index);
     if (!item) {
         return;
     }
@@ -778,15 +1140,14 @@ bool UnityMenuModel::event(QEvent* e)
     if (e->type() == UnityMenuModelClearEvent::eventType) {
         UnityMenuModelClearEvent *emmce = static_cast<UnityMenuModelClearEvent*>(e);
 
-        GSequenceIter *begin;
-        GSequenceIter *end;
-
         if (emmce->reset)
             beginResetModel();
 
-        begin = g_sequence_get_begin_iter (priv->items);
-        end = g_sequence_get_end_iter (priv->items);
-        g_sequence_remove_range (begin, end);
+        priv->pendingChanges.clear();
+
+        Q_FOREACH (const UnityMenuModelRow &row, priv->items)
+            menu_item_free (row.item);
+        priv->items.clear();
 
         if (emmce->reset)
             endResetModel();
@@ -795,34 +1156,50 @@ bool UnityMenuModel::event(QEvent* e)
     } else if (e->type() == UnityMenuModelAddRowEvent::eventType) {
         UnityMenuModelAddRowEvent *ummrce = static_cast<UnityMenuModelAddRowEvent*>(e);
 
-        GSequenceIter *it;
-        it = g_sequence_get_iter_at_pos (priv->items, ummrce->position);
+        const int position = qBound(0, ummrce->position, priv->items.size());
+        const int count = ummrce->items.size();
+        UnityMenuModelRow empty = { NULL, 0, 0, QString(), QString() };
+
+        if (count == 0)
+            return true;
 
-        beginInsertRows(QModelIndex(), ummrce->position, ummrce->position);
+        beginInsertRows(QModelIndex(), position, position + count - 1);
 
-        it = g_sequence_insert_before (it, g_object_ref (ummrce->item));
-        g_object_set_qdata (G_OBJECT (ummrce->item), unity_menu_model_quark (), this);
-        g_signal_connect (ummrce->item, "notify", G_CALLBACK (UnityMenuModelPrivate::menuItemChanged), it);
+        // opens the gap in one move of the rows behind it
+        priv->items.insert(position, count, empty);
+        for (int i = 0; i < count; i++) {
+            GtkMenuTrackerItem *item = ummrce->items.at(i);
+
+            priv->items[position + i].item = (GtkMenuTrackerItem *) g_object_ref (item);
+            g_object_set_qdata (G_OBJECT (item), unity_menu_model_quark (), this);
+            g_signal_connect (item, "notify", G_CALLBACK (UnityMenuModelPrivate::menuItemChanged), NULL);
+        }
+        priv->renumberRows(position);
 
         endInsertRows();
         return true;
     } else if (e->type() == UnityMenuModelRemoveRowEvent::eventType) {
         UnityMenuModelRemoveRowEvent *ummrre = static_cast<UnityMenuModelRemoveRowEvent*>(e);
 
-        GSequenceIter *it;
-        it = g_sequence_get_iter_at_pos (priv->items, ummrre->position);
-        if (!g_sequence_iter_is_end (it)) {
-            beginRemoveRows(QModelIndex(), ummrre->position, ummrre->position);
+        int last = qMin(ummrre->position + ummrre->count, priv->items.size()) - 1;
+
+        if (ummrre->position >= 0 && last >= ummrre->position) {
+            beginRemoveRows(QModelIndex(), ummrre->position, last);
 
-            g_sequence_remove (it);
+            for (int i = ummrre->position; i <= last; i++) {
+                GtkMenuTrackerItem *item = priv->items.at(i).item;
+
+                priv->pendingChanges.remove(item);
+                menu_item_free (item);
+            }
+            priv->items.remove(ummrre->position, last - ummrre->position + 1);
+            priv->renumberRows(ummrre->position);
 
             endRemoveRows();
         }
         return true;
     } else if (e->type() == UnityMenuModelDataChangeEvent::eventType) {
-        UnityMenuModelDataChangeEvent *ummdce = static_cast<UnityMenuModelDataChangeEvent*>(e);
-
-        Q_EMIT dataChanged(index(ummdce->position, 0), index(ummdce->position, 0));
+        priv->flushDataChanges();
         return true;
     }
     return QAbstractListModel::event(e);
@@ -875,7 +1252,7 @@ void UnityMenuModel::unregisterAction(UnityMenuAction* action)
  */
 char * UnityMenuModelPrivate::fullActionName(UnityMenuAction *action)
 {
-    GSequenceIter *iter;
+    GtkMenuTrackerItem *item;
     QByteArray bytes;
     const gchar *name;
     gchar *full_name = NULL;
@@ -883,16 +1260,10 @@ char * UnityMenuModelPrivate::fullActionName(UnityMenuAction *action)
     bytes = action->name().toUtf8();
     name = bytes.constData();
 
-    iter = g_sequence_get_iter_at_pos (this->items, action->index());
-    if (!g_sequence_iter_is_end (iter)) {
-        GtkMenuTrackerItem *item;
+    item = this->itemAt(action->index());
+    if (item) {
         const gchar *action_namespace;
 
-        item = (GtkMenuTrackerItem *) g_sequence_get (iter);
-        if (!item) {
-            return g_strdup (name);
-        }
-
         action_namespace = gtk_menu_tracker_item_get_action_namespace (item);
         if (action_namespace != NULL)
           return g_strjoin (".", action_namespace, name, NULL);
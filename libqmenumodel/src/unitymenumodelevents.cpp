@@ -35,29 +35,29 @@ UnityMenuModelClearEvent::UnityMenuModelClearEvent(bool _reset)
       reset(_reset)
 {}
 
-UnityMenuModelAddRowEvent::UnityMenuModelAddRowEvent(GtkMenuTrackerItem *_item, int _position)
+UnityMenuModelAddRowEvent::UnityMenuModelAddRowEvent(GtkMenuTrackerItem **_items, int _position, int _count)
     : QEvent(UnityMenuModelAddRowEvent::eventType),
-      item(_item),
       position(_position)
 {
-    if (item) {
-        g_object_ref(item);
+    items.reserve(_count);
+    for (int i = 0; i < _count; i++) {
+        items << (GtkMenuTrackerItem *) g_object_ref(_items[i]);
     }
 }
 
 UnityMenuModelAddRowEvent::~UnityMenuModelAddRowEvent()
 {
-    if (item) {
+    Q_FOREACH(GtkMenuTrackerItem *item, items) {
         g_object_unref(item);
     }
 }
 
-UnityMenuModelRemoveRowEvent::UnityMenuModelRemoveRowEvent(int _position)
+UnityMenuModelRemoveRowEvent::UnityMenuModelRemoveRowEvent(int _position, int _count)
     : QEvent(UnityMenuModelRemoveRowEvent::eventType),
-      position(_position)
+      position(_position),
+      count(_count)
 {}
 
-UnityMenuModelDataChangeEvent::UnityMenuModelDataChangeEvent(int _position)
-    : QEvent(UnityMenuModelDataChangeEvent::eventType),
-      position(_position)
+UnityMenuModelDataChangeEvent::UnityMenuModelDataChangeEvent()
+    : QEvent(UnityMenuModelDataChangeEvent::eventType)
 {}
@@ -21,6 +21,7 @@
 #define UNITYMENUMODELEVENTS_H
 
 #include <QEvent>
+#include <QVector>
 
 typedef struct _GtkMenuTrackerItem GtkMenuTrackerItem;
 
@@ -34,36 +35,35 @@ public:
     bool reset;
 };
 
-/* Event for a row add for unitymenumodel */
+/* Event for adding a span of rows to unitymenumodel */
 class UnityMenuModelAddRowEvent : public QEvent
 {
 public:
     static const QEvent::Type eventType;
-    UnityMenuModelAddRowEvent(GtkMenuTrackerItem *item, int position);
+    UnityMenuModelAddRowEvent(GtkMenuTrackerItem **items, int position, int count);
     ~UnityMenuModelAddRowEvent();
 
-    GtkMenuTrackerItem *item;
+    QVector<GtkMenuTrackerItem*> items;
     int position;
 };
 
-/* Event for a row remove for unitymenumodel */
+/* Event for removing a span of rows from unitymenumodel */
 class UnityMenuModelRemoveRowEvent : public QEvent
 {
 public:
     static const QEvent::Type eventType;
-    UnityMenuModelRemoveRowEvent(int position);
+    UnityMenuModelRemoveRowEvent(int position, int count);
 
     int position;
+    int count;
 };
 
-/* Event for a row data change for unitymenumodel */
+/* Event flushing the row data changes queued for unitymenumodel */
 class UnityMenuModelDataChangeEvent : public QEvent
 {
 public:
     static const QEvent::Type eventType;
-    UnityMenuModelDataChangeEvent(int position);
-
-    int position;
+    UnityMenuModelDataChangeEvent();
 };
 
 #endif //UNITYMENUMODELEVENTS_H
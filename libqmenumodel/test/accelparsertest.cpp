@@ -0,0 +1,66 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "accelparser.h"
+
+#include <QKeySequence>
+#include <QtTest>
+
+class AccelParserTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void toKeySequence_data()
+    {
+        QTest::addColumn<QByteArray>("accel");
+        QTest::addColumn<QKeySequence>("expected");
+
+        QTest::newRow("primary") << QByteArray("<Primary>s") << QKeySequence(Qt::CTRL + Qt::Key_S);
+        QTest::newRow("control") << QByteArray("<Control>q") << QKeySequence(Qt::CTRL + Qt::Key_Q);
+        QTest::newRow("two modifiers") << QByteArray("<Primary><Shift>n") << QKeySequence(Qt::CTRL + Qt::SHIFT + Qt::Key_N);
+        QTest::newRow("any case") << QByteArray("<ALT><shift>z") << QKeySequence(Qt::ALT + Qt::SHIFT + Qt::Key_Z);
+        QTest::newRow("function key") << QByteArray("<Alt>F4") << QKeySequence(Qt::ALT + Qt::Key_F4);
+        QTest::newRow("super") << QByteArray("<Super>e") << QKeySequence(Qt::META + Qt::Key_E);
+        QTest::newRow("no modifier") << QByteArray("Delete") << QKeySequence(Qt::Key_Delete);
+        QTest::newRow("gdk name") << QByteArray("<Primary>plus") << QKeySequence(Qt::CTRL + Qt::Key_Plus);
+        QTest::newRow("page up") << QByteArray("<Primary>Page_Up") << QKeySequence(Qt::CTRL + Qt::Key_PageUp);
+
+        // nothing usable: no shortcut rather than a wrong one
+        QTest::newRow("empty") << QByteArray("") << QKeySequence();
+        QTest::newRow("modifier only") << QByteArray("<Primary>") << QKeySequence();
+        QTest::newRow("unterminated") << QByteArray("<Primary") << QKeySequence();
+        QTest::newRow("hyper") << QByteArray("<Hyper>a") << QKeySequence();
+        QTest::newRow("mod4") << QByteArray("<Primary><Mod4>a") << QKeySequence();
+        QTest::newRow("release") << QByteArray("<Release>a") << QKeySequence();
+        QTest::newRow("unknown key") << QByteArray("<Primary>NoSuchKey") << QKeySequence();
+    }
+
+    void toKeySequence()
+    {
+        QFETCH(QByteArray, accel);
+        QFETCH(QKeySequence, expected);
+
+        QCOMPARE(AccelParser::toKeySequence(accel.constData()), expected);
+    }
+
+    void null()
+    {
+        QVERIFY(AccelParser::toKeySequence(NULL).isEmpty());
+    }
+};
+
+QTEST_GUILESS_MAIN(AccelParserTest)
+
+#include "accelparsertest.moc"
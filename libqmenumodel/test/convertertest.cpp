@@ -0,0 +1,370 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+extern "C" {
+#include <glib.h>
+}
+
+#include "allocationcounter.h"
+#include "converter.h"
+
+#include <QElapsedTimer>
+#include <QVariant>
+#include <QtTest>
+
+static const int ValuesPerSignature = 200;
+static const int RandomSignatures = 500;
+static const int BenchmarkIterations = 2000;
+
+static GVariant *randomValue(GRand *rand, const GVariantType *type);
+
+static gchar *randomString(GRand *rand)
+{
+    static const char *pieces[] = { "a", "Z", "9", " ", "-", ".", "_", "\xc3\xa9", "\xe2\x82\xac", "\xf0\x9f\x98\x80" };
+    GString *str = g_string_new(NULL);
+    for (int i = 0, n = g_rand_int_range(rand, 0, 12); i < n; i++) {
+        g_string_append(str, pieces[g_rand_int_range(rand, 0, G_N_ELEMENTS(pieces))]);
+    }
+    return g_string_free(str, FALSE);
+}
+
+static GVariant *randomBasicVariant(GRand *rand)
+{
+    static const char *basics[] = { "b", "y", "n", "q", "i", "u", "x", "t", "d", "s" };
+    GVariantType *type = g_variant_type_new(basics[g_rand_int_range(rand, 0, G_N_ELEMENTS(basics))]);
+    GVariant *value = randomValue(rand, type);
+    g_variant_type_free(type);
+    return value;
+}
+
+/* Returns a floating GVariant of @type with random contents. */
+static GVariant *randomValue(GRand *rand, const GVariantType *type)
+{
+    if (g_variant_type_equal(type, G_VARIANT_TYPE_BOOLEAN)) {
+        return g_variant_new_boolean(g_rand_boolean(rand));
+    } else if (g_variant_type_equal(type, G_VARIANT_TYPE_BYTE)) {
+        return g_variant_new_byte(g_rand_int_range(rand, 0, 256));
+    } else if (g_variant_type_equal(type, G_VARIANT_TYPE_INT16)) {
+        return g_variant_new_int16(g_rand_int_range(rand, G_MININT16, G_MAXINT16));
+    } else if (g_variant_type_equal(type, G_VARIANT_TYPE_UINT16)) {
+        return g_variant_new_uint16(g_rand_int_range(rand, 0, G_MAXUINT16));
+    } else if (g_variant_type_equal(type, G_VARIANT_TYPE_INT32)) {
+        return g_variant_new_int32((gint32) g_rand_int(rand));
+    } else if (g_variant_type_equal(type, G_VARIANT_TYPE_UINT32)) {
+        return g_variant_new_uint32(g_rand_int(rand));
+    } else if (g_variant_type_equal(type, G_VARIANT_TYPE_INT64)) {
+        return g_variant_new_int64((gint64) (((guint64) g_rand_int(rand) << 32) | g_rand_int(rand)));
+    } else if (g_variant_type_equal(type, G_VARIANT_TYPE_UINT64)) {
+        return g_variant_new_uint64(((guint64) g_rand_int(rand) << 32) | g_rand_int(rand));
+    } else if (g_variant_type_equal(type, G_VARIANT_TYPE_DOUBLE)) {
+        return g_variant_new_double(g_rand_double_range(rand, -1e9, 1e9));
+    } else if (g_variant_type_equal(type, G_VARIANT_TYPE_STRING)) {
+        gchar *str = randomString(rand);
+        GVariant *value = g_variant_new_string(str);
+        g_free(str);
+        return value;
+    } else if (g_variant_type_equal(type, G_VARIANT_TYPE_OBJECT_PATH)) {
+        return g_variant_new_object_path(g_rand_boolean(rand) ? "/" : "/com/canonical/menu");
+    } else if (g_variant_type_equal(type, G_VARIANT_TYPE_SIGNATURE)) {
+        return g_variant_new_signature(g_rand_boolean(rand) ? "" : "a{sv}");
+    } else if (g_variant_type_equal(type, G_VARIANT_TYPE_HANDLE)) {
+        return g_variant_new_handle(g_rand_int_range(rand, 0, 64));
+    } else if (g_variant_type_equal(type, G_VARIANT_TYPE_VARIANT)) {
+        return g_variant_new_variant(randomBasicVariant(rand));
+    } else if (g_variant_type_equal(type, G_VARIANT_TYPE_BYTESTRING)) {
+        // arbitrary binary data with at least one nul: a C string when the
+        // only nul is the last byte, binary data otherwise. Nul-free data
+        // reads back as a C string, so it is not generated here.
+        int n = g_rand_int_range(rand, 1, 64);
+        guchar *data = g_new(guchar, n);
+        for (int i = 0; i < n; i++) {
+            data[i] = g_rand_int_range(rand, 0, 256);
+        }
+        data[g_rand_int_range(rand, 0, n)] = 0;
+        GVariant *value = g_variant_new_fixed_array(G_VARIANT_TYPE_BYTE, data, n, 1);
+        g_free(data);
+        return value;
+    } else if (g_variant_type_equal(type, G_VARIANT_TYPE_BYTESTRING_ARRAY)) {
+        GVariantBuilder b;
+        g_variant_builder_init(&b, type);
+        for (int i = 0, n = g_rand_int_range(rand, 0, 5); i < n; i++) {
+            gchar *str = randomString(rand);
+            g_variant_builder_add_value(&b, g_variant_new_bytestring(str));
+            g_free(str);
+        }
+        return g_variant_builder_end(&b);
+    } else if (g_variant_type_is_maybe(type)) {
+        const GVariantType *element = g_variant_type_element(type);
+        return g_variant_new_maybe(element, g_rand_boolean(rand) ? randomValue(rand, element) : NULL);
+    } else if (g_variant_type_is_array(type)) {
+        const GVariantType *element = g_variant_type_element(type);
+        GVariantBuilder b;
+        g_variant_builder_init(&b, type);
+        // keys are "k0".."k8" so dictionaries come out sorted and unique,
+        // like the QVariantMap they convert to
+        for (int i = 0, n = g_rand_int_range(rand, 0, 9); i < n; i++) {
+            if (g_variant_type_is_dict_entry(element)) {
+                gchar *key = g_strdup_printf("k%d", i);
+                g_variant_builder_add_value(&b, g_variant_new_dict_entry(g_variant_new_string(key),
+                                                                         randomValue(rand, g_variant_type_value(element))));
+                g_free(key);
+            } else {
+                g_variant_builder_add_value(&b, randomValue(rand, element));
+            }
+        }
+        return g_variant_builder_end(&b);
+    } else if (g_variant_type_is_tuple(type)) {
+        GVariantBuilder b;
+        g_variant_builder_init(&b, type);
+        for (const GVariantType *item = g_variant_type_first(type); item; item = g_variant_type_next(item)) {
+            g_variant_builder_add_value(&b, randomValue(rand, item));
+        }
+        return g_variant_builder_end(&b);
+    }
+
+    qFatal("randomValue: unhandled type %s", g_variant_type_peek_string(type));
+    return NULL;
+}
+
+/*
+ * Random signatures restricted to what Converter is expected to carry
+ * through toQVariant and back: basic types, arrays and tuples of them,
+ * 'a{sv}' and 'v' holding basic values.
+ */
+static void randomSignature(GRand *rand, GString *sig, int depth)
+{
+    static const char *basics = "bynqiuxtds";
+    int choice = g_rand_int_range(rand, 0, depth > 2 ? 10 : 14);
+
+    if (choice < 10) {
+        g_string_append_c(sig, basics[choice]);
+    } else if (choice == 10) {
+        g_string_append_c(sig, 'a');
+        randomSignature(rand, sig, depth + 1);
+    } else if (choice == 11) {
+        g_string_append_c(sig, '(');
+        for (int i = 0, n = g_rand_int_range(rand, 1, 4); i < n; i++) {
+            randomSignature(rand, sig, depth + 1);
+        }
+        g_string_append_c(sig, ')');
+    } else if (choice == 12) {
+        g_string_append(sig, "a{sv}");
+    } else {
+        g_string_append_c(sig, 'v');
+    }
+}
+
+/* Converts @value to a QVariant and back; returns a new reference or NULL. */
+static GVariant *roundTrip(GVariant *value)
+{
+    const QVariant qvalue = Converter::toQVariant(value);
+    GVariant *result = Converter::toGVariantWithSchema(qvalue, g_variant_get_type_string(value));
+    return result ? g_variant_ref_sink(result) : NULL;
+}
+
+static bool checkRoundTrip(GVariant *value, QByteArray *message)
+{
+    GVariant *result = roundTrip(value);
+    bool ok = result && g_variant_equal(value, result);
+
+    if (!ok) {
+        gchar *in = g_variant_print(value, TRUE);
+        gchar *out = result ? g_variant_print(result, TRUE) : g_strdup("(null)");
+        *message = QByteArray(in) + " became " + out;
+        g_free(in);
+        g_free(out);
+    }
+    if (result) {
+        g_variant_unref(result);
+    }
+    return ok;
+}
+
+class ConverterTest : public QObject
+{
+    Q_OBJECT
+
+private:
+    GRand *m_rand;
+
+    void addSignatures()
+    {
+        QTest::addColumn<QByteArray>("signature");
+
+        const char *signatures[] = {
+            "b", "y", "n", "q", "i", "u", "x", "t", "d", "s",
+            "as", "ay", "aay", "v", "a{sv}",
+            "ai", "ad", "aas", "a(is)", "(isb)", "(a{sv}as)", "aa{sv}"
+        };
+        for (const char *sig : signatures) {
+            QTest::newRow(sig) << QByteArray(sig);
+        }
+    }
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+        // a fixed seed keeps failures reproducible; override to explore
+        guint32 seed = qEnvironmentVariableIsSet("CONVERTER_TEST_SEED")
+                ? qgetenv("CONVERTER_TEST_SEED").toUInt() : 20170101;
+        qInfo("seed: %u", seed);
+        m_rand = g_rand_new_with_seed(seed);
+    }
+
+    void cleanupTestCase()
+    {
+        g_rand_free(m_rand);
+    }
+
+    void roundTrip_data()
+    {
+        addSignatures();
+    }
+
+    void roundTrip()
+    {
+        QFETCH(QByteArray, signature);
+
+        GVariantType *type = g_variant_type_new(signature.constData());
+        for (int i = 0; i < ValuesPerSignature; i++) {
+            GVariant *value = g_variant_ref_sink(randomValue(m_rand, type));
+            QByteArray message;
+            bool ok = checkRoundTrip(value, &message);
+            g_variant_unref(value);
+            QVERIFY2(ok, message.constData());
+        }
+        g_variant_type_free(type);
+    }
+
+    void randomRoundTrip()
+    {
+        for (int i = 0; i < RandomSignatures; i++) {
+            GString *sig = g_string_new(NULL);
+            randomSignature(m_rand, sig, 0);
+
+            GVariantType *type = g_variant_type_new(sig->str);
+            GVariant *value = g_variant_ref_sink(randomValue(m_rand, type));
+            QByteArray message;
+            bool ok = checkRoundTrip(value, &message);
+
+            g_variant_unref(value);
+            g_variant_type_free(type);
+            message.prepend(QByteArray(sig->str) + ": ");
+            g_string_free(sig, TRUE);
+            QVERIFY2(ok, message.constData());
+        }
+    }
+
+    void bytestringIsByteArray()
+    {
+        GVariant *value = g_variant_ref_sink(g_variant_new_bytestring("bytes"));
+        const QVariant qvalue = Converter::toQVariant(value);
+        g_variant_unref(value);
+
+        QCOMPARE(qvalue.type(), QVariant::ByteArray);
+        QCOMPARE(qvalue.toByteArray(), QByteArray("bytes"));
+    }
+
+    /*
+     * Binary data keeps every byte, a trailing nul included, both ways.
+     */
+    void binaryBytesKeepTheirLength()
+    {
+        const QByteArray binary("a\0b\0", 4);
+        GVariant *value = g_variant_ref_sink(g_variant_new_fixed_array(G_VARIANT_TYPE_BYTE,
+                                                                       binary.constData(), binary.size(), 1));
+        const QVariant qvalue = Converter::toQVariant(value);
+        QCOMPARE(qvalue.toByteArray(), binary);
+
+        GVariant *result = g_variant_ref_sink(Converter::toGVariant(qvalue));
+        QCOMPARE(g_variant_get_size(result), gsize(binary.size()));
+        QVERIFY(g_variant_equal(value, result));
+        g_variant_unref(result);
+        g_variant_unref(value);
+    }
+
+    // Types Converter does not handle yet. These report XFAIL today and
+    // XPASS once support lands, so the list can be trimmed.
+    void knownGaps_data()
+    {
+        QTest::addColumn<QByteArray>("signature");
+
+        QTest::newRow("object path") << QByteArray("o");
+        QTest::newRow("signature") << QByteArray("g");
+        QTest::newRow("handle") << QByteArray("h");
+        QTest::newRow("maybe") << QByteArray("mi");
+        QTest::newRow("dictionary") << QByteArray("a{si}");
+        QTest::newRow("object path array") << QByteArray("ao");
+    }
+
+    void knownGaps()
+    {
+        QFETCH(QByteArray, signature);
+
+        GVariantType *type = g_variant_type_new(signature.constData());
+        bool ok = true;
+        QByteArray message;
+        for (int i = 0; i < ValuesPerSignature && ok; i++) {
+            GVariant *value = g_variant_ref_sink(randomValue(m_rand, type));
+            ok = checkRoundTrip(value, &message);
+            g_variant_unref(value);
+        }
+        g_variant_type_free(type);
+
+        QEXPECT_FAIL("", "not supported by Converter", Continue);
+        QVERIFY2(ok, message.constData());
+    }
+
+    void benchmark_data()
+    {
+        addSignatures();
+    }
+
+    void benchmark()
+    {
+        QFETCH(QByteArray, signature);
+
+        GVariantType *type = g_variant_type_new(signature.constData());
+        QVector<GVariant*> values;
+        for (int i = 0; i < 16; i++) {
+            values << g_variant_ref_sink(randomValue(m_rand, type));
+        }
+
+        const int before = allocationCount();
+        QElapsedTimer timer;
+        timer.start();
+        for (int i = 0; i < BenchmarkIterations; i++) {
+            GVariant *result = roundTrip(values.at(i % values.size()));
+            if (result) {
+                g_variant_unref(result);
+            }
+        }
+        const qint64 nsecs = qMax<qint64>(timer.nsecsElapsed(), 1);
+        const int allocated = allocationCount() - before;
+
+        qInfo("%-12s %12.0f conversions/s %8.2f allocations/conversion",
+              signature.constData(),
+              BenchmarkIterations * 1e9 / nsecs,
+              double(allocated) / BenchmarkIterations);
+
+        for (GVariant *value : values) {
+            g_variant_unref(value);
+        }
+        g_variant_type_free(type);
+    }
+};
+
+QTEST_GUILESS_MAIN(ConverterTest)
+
+#include "convertertest.moc"
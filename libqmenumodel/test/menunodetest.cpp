@@ -0,0 +1,325 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+extern "C" {
+#include <gio/gio.h>
+}
+
+#include "menunode.h"
+
+#include <QtTest>
+
+enum ItemKind {
+    Plain,
+    Section,
+    Submenu
+};
+
+/* Inserts an item of @kind at @pos; linked items get a one item child menu. */
+static void insertItem(GMenu *menu, int pos, ItemKind kind)
+{
+    GMenuItem *item;
+    GMenu *link = NULL;
+
+    if (kind == Plain) {
+        item = g_menu_item_new("plain", "app.plain");
+    } else {
+        link = g_menu_new();
+        g_menu_append(link, "child", "app.child");
+        item = (kind == Section) ? g_menu_item_new_section(NULL, G_MENU_MODEL(link))
+                                 : g_menu_item_new_submenu("submenu", G_MENU_MODEL(link));
+    }
+
+    g_menu_insert_item(menu, pos, item);
+
+    g_object_unref(item);
+    if (link) {
+        g_object_unref(link);
+    }
+}
+
+/* Checks that @node mirrors @model: one slot per item, a child node exactly
+ * for the linked items, and consistent parent/position/depth back references.
+ * Children that were not populated must stay empty. */
+static bool verifyNode(MenuNode *node, GMenuModel *model, QByteArray *message, int *count = 0)
+{
+    if (count) {
+        (*count)++;
+    }
+
+    const int n = g_menu_model_get_n_items(model);
+    if (node->size() != n) {
+        *message = QByteArray("size ") + QByteArray::number(node->size()) + " expected " + QByteArray::number(n);
+        return false;
+    }
+
+    for (int i = 0; i < n; i++) {
+        GMenuModel *link = g_menu_model_get_item_link(model, i, G_MENU_LINK_SUBMENU);
+        if (!link) {
+            link = g_menu_model_get_item_link(model, i, G_MENU_LINK_SECTION);
+        }
+
+        MenuNode *child = node->child(i);
+        bool ok = true;
+        if (!link) {
+            ok = (child == 0);
+            *message = QByteArray("unexpected child at ") + QByteArray::number(i);
+        } else if (!child || child->model() != link) {
+            ok = false;
+            *message = QByteArray("wrong child at ") + QByteArray::number(i);
+        } else if (child->parent() != node || child->position() != i) {
+            ok = false;
+            *message = QByteArray("stale back reference at ") + QByteArray::number(i);
+        } else if (child->depth() != node->depth() + 1) {
+            ok = false;
+            *message = QByteArray("stale depth at ") + QByteArray::number(i);
+        } else if (!child->isPopulated()) {
+            ok = (child->size() == 0);
+            *message = QByteArray("unpopulated child with items at ") + QByteArray::number(i);
+            if (count) {
+                (*count)++;
+            }
+        } else {
+            ok = verifyNode(child, link, message, count);
+        }
+
+        if (link) {
+            g_object_unref(link);
+        }
+        if (!ok) {
+            return false;
+        }
+    }
+    return node->child(n) == 0;
+}
+
+class MenuNodeTest : public QObject
+{
+    Q_OBJECT
+
+private:
+    GMenu *m_menu;
+    MenuNode *m_root;
+    MenuNodeIndex m_index;
+    QObject m_listener;
+
+    void verify()
+    {
+        QByteArray message;
+        int count = 0;
+        QVERIFY2(verifyNode(m_root, G_MENU_MODEL(m_menu), &message, &count), message.constData());
+        QCOMPARE(m_index.size(), count);
+    }
+
+private Q_SLOTS:
+    void init()
+    {
+        m_menu = g_menu_new();
+        m_root = new MenuNode("", G_MENU_MODEL(m_menu), 0, 0, &m_listener, &m_index);
+    }
+
+    void cleanup()
+    {
+        delete m_root;
+        QVERIFY(m_index.isEmpty());
+        g_object_unref(m_menu);
+    }
+
+    void initialTree()
+    {
+        delete m_root;
+        insertItem(m_menu, 0, Plain);
+        insertItem(m_menu, 1, Submenu);
+        insertItem(m_menu, 2, Section);
+        m_root = new MenuNode("", G_MENU_MODEL(m_menu), 0, 0, &m_listener, &m_index);
+
+        verify();
+        QCOMPARE(m_root->child(1)->linkType(), QString(G_MENU_LINK_SUBMENU));
+        QCOMPARE(m_root->child(2)->linkType(), QString(G_MENU_LINK_SECTION));
+        QCOMPARE(m_root->child(1)->depth(), 1);
+    }
+
+    void lazyPopulation()
+    {
+        insertItem(m_menu, 0, Submenu);
+        MenuNode *submenu = m_root->child(0);
+        QVERIFY(!submenu->isPopulated());
+        QCOMPARE(submenu->size(), 0);
+
+        // changes to a model nobody looked at are not tracked
+        insertItem(G_MENU(submenu->model()), 0, Submenu);
+        QCOMPARE(submenu->size(), 0);
+
+        submenu->populate();
+        QCOMPARE(submenu->size(), 2);
+        QCOMPARE(m_index.size(), 3);
+        verify();
+
+        submenu->release();
+        QVERIFY(!submenu->isPopulated());
+        QCOMPARE(submenu->size(), 0);
+        QCOMPARE(m_index.size(), 2);
+
+        insertItem(G_MENU(submenu->model()), 0, Plain);
+        QCOMPARE(submenu->size(), 0);
+        submenu->populate();
+        verify();
+    }
+
+    void insertShiftsLinkedChildren()
+    {
+        insertItem(m_menu, 0, Submenu);
+        insertItem(m_menu, 1, Section);
+        verify();
+
+        insertItem(m_menu, 0, Plain);
+        insertItem(m_menu, 0, Plain);
+        verify();
+        QVERIFY(m_root->child(0) == 0);
+        QVERIFY(m_root->child(2) != 0);
+        QVERIFY(m_root->child(3) != 0);
+    }
+
+    void removeFirstLastAndMiddle()
+    {
+        for (int i = 0; i < 6; i++) {
+            insertItem(m_menu, i, i % 2 ? Submenu : Plain);
+        }
+        verify();
+
+        g_menu_remove(m_menu, 0);
+        verify();
+        g_menu_remove(m_menu, g_menu_model_get_n_items(G_MENU_MODEL(m_menu)) - 1);
+        verify();
+        g_menu_remove(m_menu, 1);
+        verify();
+    }
+
+    void removeKeepsItemAfterRange()
+    {
+        // the item right after a removed one must survive
+        insertItem(m_menu, 0, Submenu);
+        insertItem(m_menu, 1, Section);
+        insertItem(m_menu, 2, Submenu);
+
+        g_menu_remove(m_menu, 0);
+        verify();
+        QCOMPARE(m_root->child(0)->linkType(), QString(G_MENU_LINK_SECTION));
+    }
+
+    void nestedChanges()
+    {
+        insertItem(m_menu, 0, Submenu);
+        MenuNode *submenu = m_root->child(0);
+        submenu->populate();
+        GMenu *inner = G_MENU(submenu->model());
+
+        insertItem(inner, 0, Section);
+        insertItem(inner, 2, Submenu);
+        verify();
+        QCOMPARE(submenu->child(0)->depth(), 2);
+
+        g_menu_remove(inner, 1);
+        verify();
+    }
+
+    void findThroughIndex()
+    {
+        insertItem(m_menu, 0, Plain);
+        insertItem(m_menu, 1, Submenu);
+        MenuNode *submenu = m_root->child(1);
+        submenu->populate();
+        insertItem(G_MENU(submenu->model()), 0, Section);
+        MenuNode *section = submenu->child(0);
+
+        QVERIFY(m_root->find(section->model()) == section);
+        QVERIFY(submenu->find(section->model()) == section);
+        QCOMPARE(m_root->childPosition(submenu->model()), 1);
+
+        // a node outside the subtree is not found from below
+        QVERIFY(section->find(submenu->model()) == 0);
+
+        g_menu_remove(m_menu, 1);
+        QCOMPARE(m_index.size(), 1);
+        verify();
+    }
+
+    void attributeCacheFollowsSlots()
+    {
+        for (int i = 0; i < 3; i++) {
+            insertItem(m_menu, i, Plain);
+        }
+        m_root->cacheAttribute(1, MenuNode::LabelAttribute, QString("second"));
+
+        QVariant value;
+        QVERIFY(!m_root->cachedAttribute(1, MenuNode::ActionAttribute, &value));
+        QVERIFY(m_root->cachedAttribute(1, MenuNode::LabelAttribute, &value));
+        QCOMPARE(value.toString(), QString("second"));
+
+        insertItem(m_menu, 0, Plain);
+        QVERIFY(!m_root->cachedAttribute(1, MenuNode::LabelAttribute, &value));
+        QVERIFY(m_root->cachedAttribute(2, MenuNode::LabelAttribute, &value));
+        QCOMPARE(value.toString(), QString("second"));
+
+        g_menu_remove(m_menu, 2);
+        for (int i = 0; i < m_root->size(); i++) {
+            QVERIFY(!m_root->cachedAttribute(i, MenuNode::LabelAttribute, &value));
+        }
+
+        // a new item in the same slot starts uncached
+        m_root->cacheAttribute(0, MenuNode::ExtraAttribute, QVariantMap());
+        g_menu_remove(m_menu, 0);
+        insertItem(m_menu, 0, Plain);
+        QVERIFY(!m_root->cachedAttribute(0, MenuNode::ExtraAttribute, &value));
+    }
+
+    void interleaved_data()
+    {
+        QTest::addColumn<quint32>("seed");
+
+        for (quint32 seed = 1; seed <= 8; seed++) {
+            QTest::newRow(qPrintable(QString("seed %1").arg(seed))) << seed;
+        }
+    }
+
+    void interleaved()
+    {
+        QFETCH(quint32, seed);
+        GRand *rand = g_rand_new_with_seed(seed);
+
+        for (int step = 0; step < 200; step++) {
+            const int n = g_menu_model_get_n_items(G_MENU_MODEL(m_menu));
+            if (n > 0 && g_rand_int_range(rand, 0, 3) == 0) {
+                g_menu_remove(m_menu, g_rand_int_range(rand, 0, n));
+            } else {
+                insertItem(m_menu, g_rand_int_range(rand, 0, n + 1),
+                           static_cast<ItemKind>(g_rand_int_range(rand, 0, 3)));
+            }
+
+            QByteArray message;
+            int count = 0;
+            bool ok = verifyNode(m_root, G_MENU_MODEL(m_menu), &message, &count) && (count == m_index.size());
+            if (!ok) {
+                g_rand_free(rand);
+            }
+            QVERIFY2(ok, (QByteArray("step ") + QByteArray::number(step) + ": " + message).constData());
+        }
+
+        g_rand_free(rand);
+    }
+};
+
+QTEST_GUILESS_MAIN(MenuNodeTest)
+
+#include "menunodetest.moc"
@@ -0,0 +1,186 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+extern "C" {
+#include <gio/gio.h>
+}
+
+#include "actionstateparser.h"
+#include "allocationcounter.h"
+#include "qdbusactiongroup.h"
+#include "qstateaction.h"
+
+#include <QElapsedTimer>
+#include <QSignalSpy>
+#include <QtTest>
+
+static const char BusName[] = "com.canonical.qmenumodel.test";
+static const char ObjectPath[] = "/com/canonical/qmenumodel/test/actions";
+static const int BenchmarkIterations = 100000;
+
+/*
+ * Scales int32 states by ten, so a parsed state can be told apart from a
+ * plain Converter one, and counts how often it runs.
+ */
+class CountingParser : public ActionStateParser
+{
+public:
+    CountingParser()
+        : calls(0)
+    {
+    }
+
+    QVariant toQVariant(GVariant *state) const
+    {
+        calls++;
+        if (state && g_variant_is_of_type(state, G_VARIANT_TYPE_INT32)) {
+            return QVariant(g_variant_get_int32(state) * 10);
+        }
+        return ActionStateParser::toQVariant(state);
+    }
+
+    mutable int calls;
+};
+
+/*
+ * Exports a GSimpleActionGroup on a private session bus and follows it
+ * with a QDBusActionGroup.
+ */
+class QDBusActionGroupTest : public QObject
+{
+    Q_OBJECT
+
+private:
+    GTestDBus *m_bus;
+    GDBusConnection *m_connection;
+    GSimpleActionGroup *m_group;
+    guint m_exportId;
+    guint m_ownerId;
+    CountingParser *m_parser;
+    QDBusActionGroup *m_actionGroup;
+
+    void setCount(int value)
+    {
+        g_action_group_change_action_state(G_ACTION_GROUP(m_group), "count", g_variant_new_int32(value));
+    }
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+        m_bus = g_test_dbus_new(G_TEST_DBUS_NONE);
+        g_test_dbus_up(m_bus);
+
+        m_connection = g_bus_get_sync(G_BUS_TYPE_SESSION, NULL, NULL);
+        QVERIFY(m_connection);
+
+        m_group = g_simple_action_group_new();
+        GSimpleAction *action = g_simple_action_new_stateful("count", NULL, g_variant_new_int32(0));
+        g_action_map_add_action(G_ACTION_MAP(m_group), G_ACTION(action));
+        g_object_unref(action);
+
+        m_exportId = g_dbus_connection_export_action_group(m_connection, ObjectPath, G_ACTION_GROUP(m_group), NULL);
+        QVERIFY(m_exportId != 0);
+        m_ownerId = g_bus_own_name_on_connection(m_connection, BusName, G_BUS_NAME_OWNER_FLAGS_NONE,
+                                                 NULL, NULL, NULL, NULL);
+    }
+
+    void cleanupTestCase()
+    {
+        g_bus_unown_name(m_ownerId);
+        g_dbus_connection_unexport_action_group(m_connection, m_exportId);
+        g_object_unref(m_group);
+        g_object_unref(m_connection);
+
+        g_test_dbus_down(m_bus);
+        g_object_unref(m_bus);
+    }
+
+    void init()
+    {
+        setCount(0);
+
+        m_parser = new CountingParser;
+        m_actionGroup = new QDBusActionGroup;
+        m_actionGroup->setActionStateParser(m_parser);
+        m_actionGroup->setBusType(DBusEnums::SessionBus);
+        m_actionGroup->setBusName(BusName);
+        m_actionGroup->setObjectPath(ObjectPath);
+        m_actionGroup->start();
+
+        QTRY_COMPARE(m_actionGroup->status(), DBusEnums::Connected);
+        QTRY_VERIFY(m_actionGroup->hasAction("count"));
+    }
+
+    void cleanup()
+    {
+        delete m_actionGroup;
+        delete m_parser;
+    }
+
+    /*
+     * A state change is parsed once, and the signal, the QStateAction and
+     * later actionState() reads all see that parsed value.
+     */
+    void stateChangeIsParsedOnce()
+    {
+        QStateAction *action = m_actionGroup->action("count");
+        QCOMPARE(action->state(), QVariant(0));
+
+        QSignalSpy spy(m_actionGroup, SIGNAL(actionStateChanged(QString,QVariant)));
+        m_parser->calls = 0;
+
+        setCount(7);
+        QTRY_COMPARE(spy.count(), 1);
+
+        QCOMPARE(m_parser->calls, 1);
+        QCOMPARE(spy.at(0).at(0).toString(), QString("count"));
+        QCOMPARE(spy.at(0).at(1), QVariant(70));
+        QCOMPARE(action->state(), QVariant(70));
+        QCOMPARE(m_actionGroup->actionState("count"), QVariant(70));
+        QCOMPARE(m_parser->calls, 1);
+    }
+
+    /*
+     * Once a state is known, reading it neither parses nor allocates.
+     */
+    void readBenchmark()
+    {
+        const QString name("count");
+
+        setCount(3);
+        QTRY_COMPARE(m_actionGroup->actionState(name), QVariant(30));
+        m_parser->calls = 0;
+
+        const int before = allocationCount();
+        QElapsedTimer timer;
+        timer.start();
+        for (int i = 0; i < BenchmarkIterations; i++) {
+            QVariant state = m_actionGroup->actionState(name);
+            Q_UNUSED(state);
+        }
+        const qint64 nsecs = qMax<qint64>(timer.nsecsElapsed(), 1);
+        const int allocated = allocationCount() - before;
+
+        qInfo("actionState %12.0f reads/s %8.2f allocations/read",
+              BenchmarkIterations * 1e9 / nsecs,
+              double(allocated) / BenchmarkIterations);
+
+        QCOMPARE(m_parser->calls, 0);
+        QCOMPARE(allocated, 0);
+    }
+};
+
+QTEST_GUILESS_MAIN(QDBusActionGroupTest)
+
+#include "qdbusactiongrouptest.moc"
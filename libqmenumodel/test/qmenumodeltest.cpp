@@ -0,0 +1,115 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+extern "C" {
+#include <gio/gio.h>
+}
+
+#include "qmenumodel.h"
+
+#include <QtTest>
+
+class TestMenuModel : public QMenuModel
+{
+public:
+    explicit TestMenuModel(GMenuModel *model)
+        : QMenuModel(model)
+    {
+    }
+};
+
+class QMenuModelTest : public QObject
+{
+    Q_OBJECT
+
+private:
+    GMenu *m_menu;
+    TestMenuModel *m_model;
+
+private Q_SLOTS:
+    void init()
+    {
+        GMenu *submenu = g_menu_new();
+        g_menu_append(submenu, "first", "app.first");
+        g_menu_append(submenu, "second", "app.second");
+
+        m_menu = g_menu_new();
+        g_menu_append(m_menu, "plain", "app.plain");
+        g_menu_append_submenu(m_menu, "submenu", G_MENU_MODEL(submenu));
+        g_object_unref(submenu);
+
+        m_model = new TestMenuModel(G_MENU_MODEL(m_menu));
+    }
+
+    void cleanup()
+    {
+        delete m_model;
+        g_object_unref(m_menu);
+    }
+
+    void accessorsDoNotPopulate()
+    {
+        const QModelIndex submenu = m_model->index(1, 0);
+        QVERIFY(m_model->hasChildren(submenu));
+        QCOMPARE(m_model->rowCount(submenu), 0);
+        QVERIFY(m_model->canFetchMore(submenu));
+
+        m_model->index(0, 0, submenu);
+        QCOMPARE(m_model->rowCount(submenu), 0);
+
+        QVERIFY(!m_model->canFetchMore(m_model->index(0, 0)));
+        QVERIFY(!m_model->canFetchMore(QModelIndex()));
+    }
+
+    void fetchMoreInsertsRows()
+    {
+        const QModelIndex submenu = m_model->index(1, 0);
+        QSignalSpy inserted(m_model, SIGNAL(rowsInserted(QModelIndex,int,int)));
+
+        m_model->fetchMore(submenu);
+        QCOMPARE(inserted.count(), 1);
+        QCOMPARE(inserted.at(0).at(0).value<QModelIndex>(), submenu);
+        QCOMPARE(inserted.at(0).at(1).toInt(), 0);
+        QCOMPARE(inserted.at(0).at(2).toInt(), 1);
+
+        QCOMPARE(m_model->rowCount(submenu), 2);
+        QVERIFY(!m_model->canFetchMore(submenu));
+        QCOMPARE(m_model->data(m_model->index(1, 0, submenu), QMenuModel::Label).toString(), QString("second"));
+
+        m_model->fetchMore(submenu);
+        QCOMPARE(inserted.count(), 1);
+    }
+
+    void idleReleaseSkipsHeldNodes()
+    {
+        QPersistentModelIndex submenu(m_model->index(1, 0));
+        m_model->fetchMore(submenu);
+        QSignalSpy removed(m_model, SIGNAL(rowsRemoved(QModelIndex,int,int)));
+
+        m_model->setIdleReleaseInterval(1);
+        QTest::qWait(50);
+        QCOMPARE(removed.count(), 0);
+        QCOMPARE(m_model->rowCount(submenu), 2);
+
+        const QModelIndex released = submenu;
+        submenu = QPersistentModelIndex();
+        QTRY_COMPARE(removed.count(), 1);
+        QCOMPARE(m_model->rowCount(released), 0);
+        QVERIFY(m_model->canFetchMore(released));
+    }
+};
+
+QTEST_GUILESS_MAIN(QMenuModelTest)
+
+#include "qmenumodeltest.moc"